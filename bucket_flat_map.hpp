@@ -0,0 +1,312 @@
+#pragma once
+// Sorted-vector containers with BucketSearch lookups (C++17).
+//
+// bucket_flat_set<Key> and bucket_flat_map<Key, T> behave like
+// boost::container::flat_set / flat_map with std::less over an integral
+// key: a contiguous sorted vector, iteration in key order, find /
+// lower_bound / upper_bound / equal_range / contains. Lookups go through a
+// prefix-bucket directory (the same start[] table as the C API). Single
+// inserts and erases patch the directory in place; it is rebuilt lazily
+// when a key falls outside the range it covers, when the size calls for a
+// different bucket count, and after bulk inserts.
+//
+// Bulk insert(first, last) appends and defers sorting until the next
+// lookup or iteration, so loading many elements costs one sort instead of
+// one shifted insert per element. As with std::map::insert, a key that is
+// already present keeps its existing element, and among deferred inserts
+// of the same key the first one wins.
+//
+// Lookups on a const container may sort deferred elements and rebuild the
+// directory, so even const access must not race with other access.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "bucket_search_u64.hpp"
+
+namespace bucketsearch {
+
+namespace detail {
+
+// Order-preserving map of an integral key onto uint64_t.
+template <typename Key>
+constexpr std::uint64_t key_bits(Key k) {
+  static_assert(std::is_integral<Key>::value && sizeof(Key) <= 8,
+                "bucket containers need an integral key of at most 64 bits");
+  if constexpr (std::is_signed<Key>::value) {
+    return static_cast<std::uint64_t>(static_cast<std::int64_t>(k)) ^ (std::uint64_t{1} << 63);
+  } else {
+    return static_cast<std::uint64_t>(k);
+  }
+}
+
+// start[] over n sorted keys, read through key_at(i). Prefixes are taken
+// of key_bits(k) - base_, the offset from the smallest key, so a narrow
+// range of signed keys still spreads over all buckets.
+class bucket_directory {
+ public:
+  template <typename KeyAt>
+  void rebuild(std::size_t n, KeyAt key_at) {
+    K_ = bits_for(n);
+    const std::size_t B = std::size_t{1} << K_;
+    base_ = n ? key_bits(key_at(0)) : 0;
+    W_ = bit_width_u64(n ? key_bits(key_at(n - 1)) - base_ : 0);
+
+    start_.assign(B + 1, n);
+    for (std::size_t i = 0; i < n; i++) {
+      std::uint32_t p = prefix_u64(key_bits(key_at(i)) - base_, W_, K_);
+      if (start_[p] == n) start_[p] = i;
+    }
+    std::size_t last = n;
+    for (std::size_t p = B; p-- > 0;) {
+      if (start_[p] == n) start_[p] = last;
+      else last = start_[p];
+    }
+  }
+
+  // Account for one key inserted (delta 1) or erased (delta -1), leaving n
+  // keys. Returns false when the directory must be rebuilt instead: the
+  // key is outside the range the prefixes cover, or n calls for another K.
+  template <typename Key>
+  bool update(std::size_t n, const Key &k, int delta) {
+    std::uint64_t x = key_bits(k);
+    if (bits_for(n) != K_ || x < base_ || bit_width_u64(x - base_) > W_) return false;
+    // Buckets after k's own shift by one; those up to it start where they did.
+    for (std::size_t p = prefix_u64(x - base_, W_, K_) + std::size_t{1}; p < start_.size(); p++)
+      start_[p] += static_cast<std::size_t>(delta);
+    return true;
+  }
+
+  // First index i with key_at(i) >= k (n if none).
+  template <typename Key, typename KeyAt>
+  std::size_t lower_bound(std::size_t n, KeyAt key_at, const Key &k) const {
+    if (n == 0 || !(key_at(0) < k)) return 0;
+    if (!(k <= key_at(n - 1))) return n;
+    std::uint32_t p = prefix_u64(key_bits(k) - base_, W_, K_);
+    std::size_t lo = start_[p], hi = start_[p + 1];
+    while (lo < hi) {
+      std::size_t mid = lo + ((hi - lo) >> 1);
+      if (key_at(mid) < k) lo = mid + 1;
+      else hi = mid;
+    }
+    return lo;
+  }
+
+ private:
+  // ~4 keys per bucket, at most 2^20 buckets
+  static std::uint32_t bits_for(std::size_t n) {
+    std::uint32_t K = 1;
+    while (K < 20 && (std::size_t{1} << (K + 2)) < n) K++;
+    return K;
+  }
+
+  std::vector<std::size_t> start_;
+  std::uint64_t base_ = 0;
+  std::uint32_t K_ = 1, W_ = 1;
+};
+
+// Shared storage and lazy maintenance; Value is the element type and
+// KeyOf extracts its key.
+template <typename Key, typename Value, typename KeyOf>
+class bucket_flat_base {
+ public:
+  using key_type = Key;
+  using value_type = Value;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using iterator = typename std::vector<Value>::iterator;
+  using const_iterator = typename std::vector<Value>::const_iterator;
+
+  const_iterator begin() const { normalize(); return data_.begin(); }
+  const_iterator end() const { normalize(); return data_.end(); }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator cend() const { return end(); }
+
+  bool empty() const { return data_.empty(); }
+  size_type size() const { normalize(); return data_.size(); }
+  void reserve(size_type n) { data_.reserve(n); }
+  void clear() {
+    data_.clear();
+    sorted_ = 0;
+    dir_valid_ = false;
+  }
+
+  const_iterator find(const Key &k) const {
+    size_type i = index_of(k);
+    return (i < data_.size() && KeyOf()(data_[i]) == k) ? data_.begin() + i : data_.end();
+  }
+  bool contains(const Key &k) const { return find(k) != data_.end(); }
+  size_type count(const Key &k) const { return contains(k) ? 1 : 0; }
+
+  const_iterator lower_bound(const Key &k) const { return data_.begin() + index_of(k); }
+  const_iterator upper_bound(const Key &k) const {
+    size_type i = index_of(k);
+    if (i < data_.size() && KeyOf()(data_[i]) == k) i++;
+    return data_.begin() + i;
+  }
+  std::pair<const_iterator, const_iterator> equal_range(const Key &k) const {
+    return { lower_bound(k), upper_bound(k) };
+  }
+
+  size_type erase(const Key &k) {
+    size_type i = index_of(k);
+    if (i == data_.size() || !(KeyOf()(data_[i]) == k)) return 0;
+    // k may refer to the element itself: account for it before erasing
+    dir_valid_ = dir_valid_ && dir_.update(data_.size() - 1, k, -1);
+    data_.erase(data_.begin() + i);
+    sorted_--;
+    return 1;
+  }
+  iterator erase(const_iterator pos) {
+    normalize();
+    dir_valid_ = dir_valid_ && dir_.update(data_.size() - 1, KeyOf()(*pos), -1);
+    iterator it = data_.erase(pos);
+    sorted_--;
+    return it;
+  }
+
+  // Deferred bulk insert: sorted and merged on next access.
+  template <typename InputIt>
+  void insert(InputIt first, InputIt last) {
+    data_.insert(data_.end(), first, last);
+    dir_valid_ = false;
+  }
+  void insert(std::initializer_list<Value> il) { insert(il.begin(), il.end()); }
+
+  std::pair<iterator, bool> insert(const Value &v) { return insert_at(KeyOf()(v), v); }
+  std::pair<iterator, bool> insert(Value &&v) {
+    Key k = KeyOf()(v);
+    return insert_at(k, std::move(v));
+  }
+
+ protected:
+  bucket_flat_base() = default;
+
+  // Index of the first element with key >= k, after pending work is done.
+  size_type index_of(const Key &k) const {
+    normalize();
+    if (!dir_valid_) {
+      dir_.rebuild(data_.size(), [this](size_type i) { return KeyOf()(data_[i]); });
+      dir_valid_ = true;
+    }
+    return dir_.lower_bound(data_.size(), [this](size_type i) { return KeyOf()(data_[i]); }, k);
+  }
+
+  template <typename V>
+  std::pair<iterator, bool> insert_at(const Key &k, V &&v) {
+    size_type i = index_of(k);
+    if (i < data_.size() && KeyOf()(data_[i]) == k) return { data_.begin() + i, false };
+    iterator it = data_.insert(data_.begin() + i, std::forward<V>(v));
+    sorted_++;
+    dir_valid_ = dir_.update(data_.size(), k, 1);
+    return { it, true };
+  }
+
+  // Merge the deferred tail into the sorted prefix, first key wins.
+  void normalize() const {
+    if (sorted_ == data_.size()) return;
+    auto less = [](const Value &x, const Value &y) { return KeyOf()(x) < KeyOf()(y); };
+    auto mid = data_.begin() + static_cast<difference_type>(sorted_);
+    std::stable_sort(mid, data_.end(), less);
+    std::inplace_merge(data_.begin(), mid, data_.end(), less);
+    auto same = [](const Value &x, const Value &y) { return KeyOf()(x) == KeyOf()(y); };
+    data_.erase(std::unique(data_.begin(), data_.end(), same), data_.end());
+    sorted_ = data_.size();
+    dir_valid_ = false;
+  }
+
+  mutable std::vector<Value> data_;
+  mutable size_type sorted_ = 0;       // data_[0..sorted_) is sorted and unique
+  mutable detail::bucket_directory dir_;
+  mutable bool dir_valid_ = false;
+};
+
+template <typename Key>
+struct identity_key {
+  const Key &operator()(const Key &k) const { return k; }
+};
+
+template <typename Key, typename T>
+struct pair_first_key {
+  const Key &operator()(const std::pair<Key, T> &v) const { return v.first; }
+};
+
+}  // namespace detail
+
+template <typename Key>
+class bucket_flat_set
+    : public detail::bucket_flat_base<Key, Key, detail::identity_key<Key>> {
+  using base = detail::bucket_flat_base<Key, Key, detail::identity_key<Key>>;
+
+ public:
+  using base::insert;
+
+  bucket_flat_set() = default;
+  bucket_flat_set(std::initializer_list<Key> il) { this->insert(il.begin(), il.end()); }
+  template <typename InputIt>
+  bucket_flat_set(InputIt first, InputIt last) { this->insert(first, last); }
+
+  // Elements of a set are immutable: expose only const iteration.
+  typename base::const_iterator begin() const { return base::begin(); }
+  typename base::const_iterator end() const { return base::end(); }
+};
+
+template <typename Key, typename T>
+class bucket_flat_map
+    : public detail::bucket_flat_base<Key, std::pair<Key, T>, detail::pair_first_key<Key, T>> {
+  using base = detail::bucket_flat_base<Key, std::pair<Key, T>, detail::pair_first_key<Key, T>>;
+
+ public:
+  using mapped_type = T;
+  using typename base::iterator;
+  using typename base::const_iterator;
+  using base::insert;
+  using base::find;
+  using base::begin;
+  using base::end;
+
+  bucket_flat_map() = default;
+  bucket_flat_map(std::initializer_list<std::pair<Key, T>> il) { this->insert(il.begin(), il.end()); }
+  template <typename InputIt>
+  bucket_flat_map(InputIt first, InputIt last) { this->insert(first, last); }
+
+  // Mutable iteration; changing an element's key breaks the container.
+  iterator begin() { this->normalize(); return this->data_.begin(); }
+  iterator end() { this->normalize(); return this->data_.end(); }
+
+  iterator find(const Key &k) {
+    std::size_t i = this->index_of(k);
+    return (i < this->data_.size() && this->data_[i].first == k) ? this->data_.begin() + i : this->data_.end();
+  }
+
+  T &operator[](const Key &k) { return this->insert_at(k, std::pair<Key, T>(k, T())).first->second; }
+
+  T &at(const Key &k) {
+    iterator it = find(k);
+    if (it == this->data_.end()) throw std::out_of_range("bucket_flat_map::at");
+    return it->second;
+  }
+  const T &at(const Key &k) const {
+    const_iterator it = find(k);
+    if (it == this->data_.end()) throw std::out_of_range("bucket_flat_map::at");
+    return it->second;
+  }
+
+  template <typename M>
+  std::pair<iterator, bool> insert_or_assign(const Key &k, M &&obj) {
+    iterator it = find(k);
+    if (it != this->data_.end()) {
+      it->second = std::forward<M>(obj);
+      return { it, false };
+    }
+    return this->insert_at(k, std::pair<Key, T>(k, T(std::forward<M>(obj))));
+  }
+};
+
+}  // namespace bucketsearch
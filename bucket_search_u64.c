@@ -1,24 +1,99 @@
 #include "bucket_search_u64.h"
 
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
 #if defined(__GNUC__) || defined(__clang__)
-  #define BS_CLZ64(x) __builtin_clzll(x)
+  #define BS_POPCNT64(x) ((uint32_t)__builtin_popcountll(x))
+  #define BS_PREFETCH(p) __builtin_prefetch((p), 0, 3)
 #else
-  static uint32_t BS_CLZ64_fallback(uint64_t x){
-    uint32_t n = 0;
-    while ((x & (1ull<<63)) == 0 && x) { x <<= 1; n++; }
-    return n;
+  static uint32_t BS_POPCNT64_fallback(uint64_t x){
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (uint32_t)((x * 0x0101010101010101ull) >> 56);
   }
-  #define BS_CLZ64(x) BS_CLZ64_fallback(x)
+  #define BS_POPCNT64(x) BS_POPCNT64_fallback(x)
+  #define BS_PREFETCH(p) ((void)(p))
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+  #define BS_LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+  #define BS_CAS_PUBLISH(p, expected, desired) \
+    __atomic_compare_exchange_n((p), (expected), (desired), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#else
+  // no atomics available: lazy directories are single-threaded only
+  #define BS_LOAD_ACQUIRE(p) (*(p))
+  #define BS_CAS_PUBLISH(p, expected, desired) \
+    ((*(p) == *(expected)) ? (*(p) = (desired), 1) : (*(expected) = *(p), 0))
+#endif
+
+// Lookup instrumentation, compiled out unless requested:
+//   -DBUCKETSEARCH_STATS  per-thread counters, read with bucketsearch_u64_stats_get
+//   -DBUCKETSEARCH_USDT   static probes bucketsearch:{lookup,empty,reject,search,found}
+#ifdef BUCKETSEARCH_STATS
+  #if defined(__GNUC__) || defined(__clang__)
+    static __thread bucketsearch_u64_stats bs_stats;
+  #else
+    static _Thread_local bucketsearch_u64_stats bs_stats;
+  #endif
+  #define BS_STAT_ADD(field, v) (bs_stats.field += (v))
+#else
+  #define BS_STAT_ADD(field, v) ((void)0)
+#endif
+
+#ifdef BUCKETSEARCH_USDT
+  #include <sys/sdt.h>
+  #define BS_USDT1(name, a) DTRACE_PROBE1(bucketsearch, name, a)
+  #define BS_USDT2(name, a, b) DTRACE_PROBE2(bucketsearch, name, a, b)
+  #define BS_USDT3(name, a, b, c) DTRACE_PROBE3(bucketsearch, name, a, b, c)
+#else
+  #define BS_USDT1(name, a) ((void)0)
+  #define BS_USDT2(name, a, b) ((void)0)
+  #define BS_USDT3(name, a, b, c) ((void)0)
 #endif
 
+// x entered a directory lookup
+#define BS_ON_LOOKUP(x) \
+  do { BS_STAT_ADD(lookups, 1); BS_USDT1(lookup, x); } while (0)
+// bucket p holds no keys
+#define BS_ON_EMPTY(x, p) \
+  do { BS_STAT_ADD(empty_rejects, 1); BS_USDT2(empty, x, p); } while (0)
+// x lies outside [first, last] of bucket p (or above the largest key)
+#define BS_ON_REJECT(x, p) \
+  do { BS_STAT_ADD(range_rejects, 1); BS_USDT2(reject, x, p); } while (0)
+// non-empty bucket p reached
+#define BS_ON_BUCKET(x, p) BS_STAT_ADD(dir_hits, 1)
+// search over len keys starts; depth is the bit width of len, as in the
+// adaptive index
+#define BS_ON_SEARCH(x, p, len) \
+  do { BS_STAT_ADD(searches, 1); BS_STAT_ADD(probe_depth, bit_width_u64(len)); \
+       BS_USDT3(search, x, p, len); } while (0)
+// x found at index i
+#define BS_ON_FOUND(x, i) \
+  do { BS_STAT_ADD(found, 1); BS_USDT2(found, x, i); } while (0)
+
 static inline uint32_t bit_width_u64(uint64_t x) {
-  if (x == 0) return 1;
-  return 64u - (uint32_t)BS_CLZ64(x);
+  return bucketsearch_u64_bit_width(x);
+}
+
+// Final answer of an instrumented lookup.
+static inline ptrdiff_t lookup_result(uint64_t x, ptrdiff_t r) {
+  if (r >= 0) BS_ON_FOUND(x, r);
+  (void)x;
+  return r;
 }
 
 static inline uint32_t prefix_u64(uint64_t x, uint32_t W, uint32_t K) {
-  if (W >= K) return (uint32_t)(x >> (W - K));
-  return (uint32_t)(x << (K - W));
+  return bucketsearch_u64_prefix(x, W, K);
+}
+
+// Smallest value whose K-bit prefix is >= p (p < 2^K).
+static inline uint64_t prefix_floor_u64(uint32_t p, uint32_t W, uint32_t K) {
+  if (W >= K) return (uint64_t)p << (W - K);
+  uint32_t s = K - W;
+  return ((uint64_t)p + (1ull << s) - 1) >> s;
 }
 
 static inline size_t lower_bound_u64(const uint64_t *a, size_t lo, size_t hi, uint64_t x) {
@@ -30,6 +105,32 @@ static inline size_t lower_bound_u64(const uint64_t *a, size_t lo, size_t hi, ui
   return lo;
 }
 
+// Same result as lower_bound_u64 for lo < hi, without data-dependent branches.
+static inline size_t lower_bound_branchless_u64(const uint64_t *a, size_t lo, size_t hi, uint64_t x) {
+  const uint64_t *base = a + lo;
+  size_t len = hi - lo;
+  while (len > 1) {
+    size_t half = len >> 1;
+    base = (base[half] < x) ? base + half : base;
+    len -= half;
+  }
+  return (size_t)(base - a) + (*base < x);
+}
+
+// Count of keys < x; written so the compiler can vectorize it.
+static inline size_t lower_bound_scan_u64(const uint64_t *a, size_t lo, size_t hi, uint64_t x) {
+  size_t c = 0;
+  for (size_t i = lo; i < hi; i++) c += (a[i] < x);
+  return lo + c;
+}
+
+static int is_dense_run(const uint64_t *a, size_t lo, size_t hi) {
+  if (a[hi - 1] - a[lo] != (uint64_t)(hi - 1 - lo)) return 0;
+  size_t i = lo + 1;
+  while (i < hi && a[i] == a[i - 1] + 1) i++;
+  return i == hi;
+}
+
 int bucketsearch_u64_build(const uint64_t *a, size_t n, uint32_t K, size_t *start) {
   if (!start) return -1;
   if (K == 0 || K > 24) return -2;          // keep table reasonable (you can raise)
@@ -58,6 +159,76 @@ int bucketsearch_u64_build(const uint64_t *a, size_t n, uint32_t K, size_t *star
   return 0;
 }
 
+// First index >= lo with a[i] >= x, probing lo+1, lo+3, lo+7, ... first.
+static inline size_t gallop_lower_bound_u64(const uint64_t *a, size_t lo, size_t n, uint64_t x) {
+  size_t hi = lo, step = 1;
+  while (hi < n && a[hi] < x) {
+    lo = hi + 1;
+    hi += step;
+    step <<= 1;
+  }
+  return lower_bound_u64(a, lo, hi < n ? hi : n, x);
+}
+
+int bucketsearch_u64_build_keys_slice(const uint64_t *a, size_t n, uint32_t K, size_t *start,
+                                      size_t lo, size_t hi) {
+  if (!start || (n && !a)) return -1;
+  if (K == 0 || K > 24) return -2;
+  if (lo > hi || hi > n) return -3;
+  const uint32_t B = 1u << K;
+  const uint32_t W = bit_width_u64(n ? a[n - 1] : 0);
+
+  // every entry up to p(a[i]) not written yet starts at i
+  uint32_t next = lo ? prefix_u64(a[lo - 1], W, K) + 1 : 0;
+  for (size_t i = lo; i < hi; i++) {
+    uint32_t p = prefix_u64(a[i], W, K);
+    while (next <= p) start[next++] = i;
+  }
+  if (hi == n) {
+    while (next <= B) start[next++] = n;
+  }
+  return 0;
+}
+
+int bucketsearch_u64_build_bounds_slice(const uint64_t *a, size_t n, uint32_t K, size_t *start,
+                                        uint32_t p0, uint32_t p1) {
+  if (!start || (n && !a)) return -1;
+  if (K == 0 || K > 24) return -2;
+  const uint32_t B = 1u << K;
+  if (p0 > p1 || p1 > B) return -3;
+  const uint32_t W = bit_width_u64(n ? a[n - 1] : 0);
+
+  size_t i = (p0 < p1) ? lower_bound_u64(a, 0, n, prefix_floor_u64(p0, W, K)) : 0;
+  for (uint32_t p = p0; p < p1; p++) {
+    i = gallop_lower_bound_u64(a, i, n, prefix_floor_u64(p, W, K));
+    start[p] = i;
+  }
+  if (p1 == B) start[B] = n;
+  return 0;
+}
+
+int bucketsearch_u64_build_from(uint32_t (*bucket)(const void *ctx, size_t i), const void *ctx,
+                                size_t n, uint32_t K, size_t *start) {
+  if (!bucket || !start) return -1;
+  if (K == 0 || K > 24) return -2;
+  const uint32_t B = 1u << K;
+
+  // every entry up to bucket(i) not written yet starts at i
+  uint32_t next = 0;
+  for (size_t i = 0; i < n; i++) {
+    uint32_t p = bucket(ctx, i);
+    if (p >= B) return -3;
+    while (next <= p) start[next++] = i;
+  }
+  while (next <= B) start[next++] = n;
+  return 0;
+}
+
+int bucketsearch_u64_build_bounds(const uint64_t *a, size_t n, uint32_t K, size_t *start) {
+  if (K == 0 || K > 24) return -2;
+  return bucketsearch_u64_build_bounds_slice(a, n, K, start, 0, 1u << K);
+}
+
 ptrdiff_t bucketsearch_u64_find(const uint64_t *a, size_t n,
                                uint32_t K, const size_t *start,
                                uint64_t x) {
@@ -67,19 +238,1191 @@ ptrdiff_t bucketsearch_u64_find(const uint64_t *a, size_t n,
 
   // Same W rule as build: depends on max element (a[n-1])
   uint32_t W = bit_width_u64(a[n - 1]);
+  BS_ON_LOOKUP(x);
 
   uint32_t p = prefix_u64(x, W, K);
-  if (p >= B) return -1;
+  if (p >= B) { BS_ON_REJECT(x, p); return -1; }
 
   size_t lo = start[p];
   size_t hi = start[p + 1];
-  if (lo == hi) return -1;
+  if (lo == hi) { BS_ON_EMPTY(x, p); return -1; }
+  BS_ON_BUCKET(x, p);
 
   // quick reject
-  if (x < a[lo] || x > a[hi - 1]) return -1;
+  if (x < a[lo] || x > a[hi - 1]) { BS_ON_REJECT(x, p); return -1; }
+
+  BS_ON_SEARCH(x, p, hi - lo);
+  size_t i = lower_bound_u64(a, lo, hi, x);
+  if (i != hi && a[i] == x) return lookup_result(x, (ptrdiff_t)i);
+  return -1;
+}
+
+
+#define BATCH_GROUP 16
+
+void bucketsearch_u64_find_batch(const uint64_t *a, size_t n,
+                                 uint32_t K, const size_t *start,
+                                 const uint64_t *xs, size_t m, ptrdiff_t *out) {
+  if (!a || !start || n == 0 || K == 0 || K > 24) {
+    for (size_t j = 0; j < m; j++) out[j] = -1;
+    return;
+  }
+  const uint32_t B = 1u << K;
+  uint32_t W = bit_width_u64(a[n - 1]);
+  uint32_t p[BATCH_GROUP];
+  size_t lo[BATCH_GROUP], hi[BATCH_GROUP];
+
+  for (size_t g = 0; g < m; g += BATCH_GROUP) {
+    size_t cnt = (m - g < BATCH_GROUP) ? m - g : BATCH_GROUP;
+    const uint64_t *x = xs + g;
+
+    // stage 1: directory entries
+    for (size_t j = 0; j < cnt; j++) {
+      p[j] = prefix_u64(x[j], W, K);
+      if (p[j] < B) BS_PREFETCH(&start[p[j]]);
+    }
+    // stage 2: bucket bounds, first probe of each bucket
+    for (size_t j = 0; j < cnt; j++) {
+      if (p[j] >= B) { lo[j] = hi[j] = 0; continue; }
+      lo[j] = start[p[j]];
+      hi[j] = start[p[j] + 1];
+      if (lo[j] != hi[j]) BS_PREFETCH(&a[lo[j] + ((hi[j] - lo[j]) >> 1)]);
+    }
+    // stage 3: search, mostly from cache now
+    for (size_t j = 0; j < cnt; j++) {
+      ptrdiff_t r = -1;
+      BS_ON_LOOKUP(x[j]);
+      if (lo[j] != hi[j] && x[j] >= a[lo[j]] && x[j] <= a[hi[j] - 1]) {
+        BS_ON_BUCKET(x[j], p[j]);
+        BS_ON_SEARCH(x[j], p[j], hi[j] - lo[j]);
+        size_t i = lower_bound_u64(a, lo[j], hi[j], x[j]);
+        if (i != hi[j] && a[i] == x[j]) r = lookup_result(x[j], (ptrdiff_t)i);
+      } else if (lo[j] == hi[j] && p[j] < B) {
+        BS_ON_EMPTY(x[j], p[j]);
+      } else {
+        if (p[j] < B) BS_ON_BUCKET(x[j], p[j]);
+        BS_ON_REJECT(x[j], p[j]);
+      }
+      out[g + j] = r;
+    }
+  }
+}
+
+int bucketsearch_u64_build_dense(const uint64_t *a, size_t n, uint32_t K,
+                                 const size_t *start, uint64_t *dense) {
+  if (!start || !dense || (n && !a)) return -1;
+  if (K == 0 || K > 24) return -2;
+  const uint32_t B = 1u << K;
+
+  for (uint32_t w = 0; w < (B + 63) / 64; w++) dense[w] = 0;
+
+  for (uint32_t p = 0; p < B; p++) {
+    size_t lo = start[p];
+    size_t hi = start[p + 1];
+    if (lo == hi) continue;
+    if (!is_dense_run(a, lo, hi)) continue;
+    dense[p >> 6] |= 1ull << (p & 63);
+  }
+  return 0;
+}
+
+ptrdiff_t bucketsearch_u64_find_dense(const uint64_t *a, size_t n,
+                                      uint32_t K, const size_t *start,
+                                      const uint64_t *dense, uint64_t x) {
+  if (!a || !start || !dense || n == 0) return -1;
+  if (K == 0 || K > 24) return -1;
+  const uint32_t B = 1u << K;
+
+  uint32_t W = bit_width_u64(a[n - 1]);
+
+  BS_ON_LOOKUP(x);
+  uint32_t p = prefix_u64(x, W, K);
+  if (p >= B) { BS_ON_REJECT(x, p); return -1; }
+
+  size_t lo = start[p];
+  size_t hi = start[p + 1];
+  if (lo == hi) { BS_ON_EMPTY(x, p); return -1; }
+  BS_ON_BUCKET(x, p);
+
+  if (dense[p >> 6] & (1ull << (p & 63))) {
+    // x < a[lo] wraps around, so one compare covers both ends
+    uint64_t d = x - a[lo];
+    if (d < (uint64_t)(hi - lo)) return lookup_result(x, (ptrdiff_t)(lo + d));
+    BS_ON_REJECT(x, p);
+    return -1;
+  }
+
+  if (x < a[lo] || x > a[hi - 1]) { BS_ON_REJECT(x, p); return -1; }
+
+  BS_ON_SEARCH(x, p, hi - lo);
+  size_t i = lower_bound_u64(a, lo, hi, x);
+  if (i != hi && a[i] == x) return lookup_result(x, (ptrdiff_t)i);
+  return -1;
+}
+
+// ---------------- rank bitmap ----------------
+
+static inline size_t bitmap_blocks(uint64_t span) {
+  return (size_t)((span + 511) >> 9);
+}
+
+size_t bucketsearch_u64_bitmap_words(const uint64_t *a, size_t n) {
+  if (!a || n == 0) return 0;
+  uint64_t span = a[n - 1] - a[0];
+  if (span / BUCKETSEARCH_BITMAP_MAX_SPAN >= (uint64_t)n) return 0;
+  span += 1;
+  size_t nb = bitmap_blocks(span);
+  return nb * 8 + nb + 1;
+}
+
+int bucketsearch_u64_bitmap_build(const uint64_t *a, size_t n, uint64_t *words,
+                                  bucketsearch_u64_bitmap *bm) {
+  if (!words || !bm) return -1;
+  size_t total = bucketsearch_u64_bitmap_words(a, n);
+  if (total == 0) return -2;
+
+  uint64_t span = a[n - 1] - a[0] + 1;
+  size_t nb = bitmap_blocks(span);
+  uint64_t *rank = words;
+  uint64_t *bits = words + nb + 1;
+
+  // check the order first: an out-of-order key may lie outside the span
+  for (size_t i = 1; i < n; i++) {
+    if (a[i] <= a[i - 1]) return -3;
+  }
+  for (size_t w = 0; w < nb * 8; w++) bits[w] = 0;
+  for (size_t i = 0; i < n; i++) {
+    uint64_t d = a[i] - a[0];
+    bits[d >> 6] |= 1ull << (d & 63);
+  }
+
+  uint64_t r = 0;
+  for (size_t b = 0; b < nb; b++) {
+    rank[b] = r;
+    for (uint32_t w = 0; w < 8; w++) r += BS_POPCNT64(bits[b * 8 + w]);
+  }
+  rank[nb] = r;
+
+  bm->base = a[0];
+  bm->span = span;
+  bm->n = n;
+  bm->rank = rank;
+  bm->bits = bits;
+  return 0;
+}
+
+// number of set bits strictly before bit d (d < span)
+static inline size_t bitmap_rank(const bucketsearch_u64_bitmap *bm, uint64_t d) {
+  size_t b = (size_t)(d >> 9);
+  const uint64_t *blk = bm->bits + b * 8;
+  uint32_t w = (uint32_t)((d >> 6) & 7);
+  size_t r = (size_t)bm->rank[b];
+  for (uint32_t j = 0; j < w; j++) r += BS_POPCNT64(blk[j]);
+  return r + BS_POPCNT64(blk[w] & ((1ull << (d & 63)) - 1));
+}
+
+ptrdiff_t bucketsearch_u64_bitmap_find(const bucketsearch_u64_bitmap *bm, uint64_t x) {
+  if (!bm || bm->n == 0) return -1;
+  uint64_t d = x - bm->base;   // x < base wraps past span
+  if (d >= bm->span) return -1;
+  if (!(bm->bits[d >> 6] & (1ull << (d & 63)))) return -1;
+  return (ptrdiff_t)bitmap_rank(bm, d);
+}
+
+size_t bucketsearch_u64_bitmap_lower_bound(const bucketsearch_u64_bitmap *bm, uint64_t x) {
+  if (!bm || bm->n == 0 || x <= bm->base) return 0;
+  uint64_t d = x - bm->base;
+  if (d >= bm->span) return bm->n;
+  return bitmap_rank(bm, d);
+}
+
+// ---------------- cuckoo sidecar ----------------
+
+#define CUCKOO_WAYS 4
+#define CUCKOO_MAX_KICKS 512
+#define CUCKOO_ATTEMPTS 8
+
+static inline size_t cuckoo_buckets(size_t n) {
+  // ~90% load; 4-way two-choice cuckoo holds up to ~97%
+  size_t nb = (n + n / 9) / CUCKOO_WAYS + 1;
+  return nb < 2 ? 2 : nb;
+}
+
+static inline uint64_t cuckoo_mix(uint64_t x, uint64_t seed) {
+  x ^= seed;
+  x ^= x >> 33; x *= 0xFF51AFD7ED558CCDull;
+  x ^= x >> 33; x *= 0xC4CEB9FE1A85EC53ull;
+  return x ^ (x >> 33);
+}
+
+// map 32 hash bits onto [0, nb) without a division
+static inline size_t cuckoo_reduce(uint32_t h, size_t nb) {
+  return (size_t)(((uint64_t)h * (uint64_t)nb) >> 32);
+}
+
+size_t bucketsearch_u64_cuckoo_words(size_t n) {
+  return cuckoo_buckets(n) * 2 * CUCKOO_WAYS + 8;  // +8 for alignment slack
+}
+
+// slot j of bucket b: key at 2j, index + 1 at 2j + 1 (0 = empty)
+static int cuckoo_insert(uint64_t *slots, size_t nb, uint64_t seed,
+                         uint64_t key, uint64_t val, uint64_t *rng) {
+  for (uint32_t kick = 0; kick < CUCKOO_MAX_KICKS; kick++) {
+    uint64_t h = cuckoo_mix(key, seed);
+    size_t b1 = cuckoo_reduce((uint32_t)(h >> 32), nb);
+    size_t b2 = cuckoo_reduce((uint32_t)h, nb);
+    uint64_t *s1 = slots + b1 * 2 * CUCKOO_WAYS;
+    uint64_t *s2 = slots + b2 * 2 * CUCKOO_WAYS;
+    for (uint32_t j = 0; j < CUCKOO_WAYS; j++) {
+      if (s1[2 * j + 1] == 0) { s1[2 * j] = key; s1[2 * j + 1] = val; return 0; }
+    }
+    for (uint32_t j = 0; j < CUCKOO_WAYS; j++) {
+      if (s2[2 * j + 1] == 0) { s2[2 * j] = key; s2[2 * j + 1] = val; return 0; }
+    }
+    // both full: evict a pseudo-random victim and re-home it
+    *rng = *rng * 6364136223846793005ull + 1442695040888963407ull;
+    uint64_t *s = ((*rng >> 40) & 1) ? s2 : s1;
+    uint32_t j = (uint32_t)(*rng >> 60) % CUCKOO_WAYS;
+    uint64_t vk = s[2 * j], vv = s[2 * j + 1];
+    s[2 * j] = key; s[2 * j + 1] = val;
+    key = vk; val = vv;
+  }
+  return -1;
+}
+
+int bucketsearch_u64_cuckoo_build(const uint64_t *a, size_t n, uint64_t *words,
+                                  bucketsearch_u64_cuckoo *h) {
+  if (!words || !h || (n && !a)) return -1;
+  size_t nb = cuckoo_buckets(n);
+  if ((uint64_t)nb >> 32) return -2;   // 32-bit bucket reduction
+
+  uint64_t *slots = words;
+  while ((uintptr_t)slots & 63) slots++;
+
+  uint64_t seed = 0x9E3779B97F4A7C15ull;
+  for (uint32_t attempt = 0; attempt < CUCKOO_ATTEMPTS; attempt++) {
+    for (size_t w = 0; w < nb * 2 * CUCKOO_WAYS; w++) slots[w] = 0;
+    uint64_t rng = seed;
+    size_t i = 0;
+    for (; i < n; i++) {
+      if (i && a[i] == a[i - 1]) continue;
+      if (cuckoo_insert(slots, nb, seed, a[i], (uint64_t)i + 1, &rng) != 0) break;
+    }
+    if (i == n) {
+      h->slots = slots;
+      h->nbuckets = nb;
+      h->seed = seed;
+      return 0;
+    }
+    seed = cuckoo_mix(seed, attempt + 1);
+  }
+  return -3;
+}
+
+ptrdiff_t bucketsearch_u64_cuckoo_find(const bucketsearch_u64_cuckoo *h, uint64_t x) {
+  uint64_t hv = cuckoo_mix(x, h->seed);
+  const uint64_t *s1 = h->slots + cuckoo_reduce((uint32_t)(hv >> 32), h->nbuckets) * 2 * CUCKOO_WAYS;
+  const uint64_t *s2 = h->slots + cuckoo_reduce((uint32_t)hv, h->nbuckets) * 2 * CUCKOO_WAYS;
+  for (uint32_t j = 0; j < CUCKOO_WAYS; j++) {
+    if (s1[2 * j] == x && s1[2 * j + 1]) return (ptrdiff_t)s1[2 * j + 1] - 1;
+  }
+  for (uint32_t j = 0; j < CUCKOO_WAYS; j++) {
+    if (s2[2 * j] == x && s2[2 * j + 1]) return (ptrdiff_t)s2[2 * j + 1] - 1;
+  }
+  return -1;
+}
+
+// ---------------- per-bucket linear model ----------------
+
+// Offset of x inside a bucket of cnt keys starting at value base.
+// Monotone in x, which is what makes the +-err window exact for misses too.
+static inline size_t model_predict(uint64_t x, uint64_t base, float slope, size_t cnt) {
+  size_t p = (size_t)((float)(x - base) * slope);
+  return p < cnt ? p : cnt - 1;
+}
+
+int bucketsearch_u64_build_model(const uint64_t *a, size_t n, uint32_t K,
+                                 const size_t *start, bucketsearch_u64_model *model) {
+  if (!start || !model) return -1;
+  if (K == 0 || K > 24) return -2;
+  const uint32_t B = 1u << K;
+  (void)n;
+
+  for (uint32_t p = 0; p < B; p++) {
+    size_t lo = start[p];
+    size_t hi = start[p + 1];
+    model[p].slope = 0.0f;
+    model[p].err = 0;
+    if (hi - lo < 2) continue;
+
+    uint64_t span = a[hi - 1] - a[lo];
+    if (span) model[p].slope = (float)((double)(hi - lo - 1) / (double)span);
+
+    size_t err = 0;
+    for (size_t i = lo; i < hi; i++) {
+      size_t pred = model_predict(a[i], a[lo], model[p].slope, hi - lo);
+      size_t off = i - lo;
+      size_t e = off > pred ? off - pred : pred - off;
+      if (e > err) err = e;
+    }
+    // too wide to store: the lookup searches the whole bucket instead
+    model[p].err = err >= BUCKETSEARCH_MODEL_ERR_WIDE ? BUCKETSEARCH_MODEL_ERR_WIDE : (uint32_t)err;
+  }
+  return 0;
+}
+
+ptrdiff_t bucketsearch_u64_find_model(const uint64_t *a, size_t n,
+                                      uint32_t K, const size_t *start,
+                                      const bucketsearch_u64_model *model,
+                                      uint64_t x) {
+  if (!a || !start || !model || n == 0) return -1;
+  if (K == 0 || K > 24) return -1;
+  const uint32_t B = 1u << K;
+
+  uint32_t W = bit_width_u64(a[n - 1]);
+
+  BS_ON_LOOKUP(x);
+  uint32_t p = prefix_u64(x, W, K);
+  if (p >= B) { BS_ON_REJECT(x, p); return -1; }
+
+  size_t lo = start[p];
+  size_t hi = start[p + 1];
+  if (lo == hi) { BS_ON_EMPTY(x, p); return -1; }
+  BS_ON_BUCKET(x, p);
+
+  if (x < a[lo] || x > a[hi - 1]) { BS_ON_REJECT(x, p); return -1; }
+
+  // lower bound of x lies in [pred - err, pred + err + 1]
+  size_t pred = lo + model_predict(x, a[lo], model[p].slope, hi - lo);
+  size_t err = model[p].err;
+  size_t wlo = lo, whi = hi;
+  if (model[p].err != BUCKETSEARCH_MODEL_ERR_WIDE) {
+    if (pred - lo > err) wlo = pred - err;
+    if (hi - pred > err + 1) whi = pred + err + 1;
+  }
+
+  BS_ON_SEARCH(x, p, whi - wlo);
+  size_t i = lower_bound_u64(a, wlo, whi, x);
+  if (i != hi && a[i] == x) return lookup_result(x, (ptrdiff_t)i);
+  return -1;
+}
+
+// ---------------- tagged directory ----------------
+
+int bucketsearch_u64_build_tagged(const uint64_t *a, size_t n, uint32_t K, size_t *start) {
+  if (n > BUCKETSEARCH_TAG_MASK) return -3;
+  int rc = bucketsearch_u64_build(a, n, K, start);
+  if (rc != 0) return rc;
+  const uint32_t B = 1u << K;
+
+  for (uint32_t p = 0; p < B; p++) {
+    size_t lo = start[p];
+    size_t hi = start[p + 1];   // not tagged yet: the loop runs upward
+    size_t cls;
+    if (lo == hi) cls = BUCKETSEARCH_EMPTY;
+    else if (hi - lo == 1) cls = BUCKETSEARCH_SINGLE;
+    else if (is_dense_run(a, lo, hi)) cls = BUCKETSEARCH_DENSE;
+    else if (hi - lo <= BUCKETSEARCH_SCAN_MAX) cls = BUCKETSEARCH_SCAN;
+    else cls = BUCKETSEARCH_WIDE;
+    start[p] = lo | (cls << BUCKETSEARCH_TAG_SHIFT);
+  }
+  return 0;
+}
+
+ptrdiff_t bucketsearch_u64_find_tagged(const uint64_t *a, size_t n,
+                                       uint32_t K, const size_t *start,
+                                       uint64_t x) {
+  if (!a || !start || n == 0) return -1;
+  if (K == 0 || K > 24) return -1;
+  const uint32_t B = 1u << K;
+
+  uint32_t W = bit_width_u64(a[n - 1]);
+
+  BS_ON_LOOKUP(x);
+  uint32_t p = prefix_u64(x, W, K);
+  if (p >= B) { BS_ON_REJECT(x, p); return -1; }
+
+  size_t e = start[p];
+  size_t lo = e & BUCKETSEARCH_TAG_MASK;
+  size_t hi, i;
+
+  switch (e >> BUCKETSEARCH_TAG_SHIFT) {
+    case BUCKETSEARCH_EMPTY:
+      BS_ON_EMPTY(x, p);
+      return -1;
+    case BUCKETSEARCH_SINGLE:
+      BS_ON_BUCKET(x, p);
+      return lookup_result(x, (a[lo] == x) ? (ptrdiff_t)lo : -1);
+    case BUCKETSEARCH_DENSE: {
+      BS_ON_BUCKET(x, p);
+      hi = start[p + 1] & BUCKETSEARCH_TAG_MASK;
+      uint64_t d = x - a[lo];
+      if (d < (uint64_t)(hi - lo)) return lookup_result(x, (ptrdiff_t)(lo + d));
+      BS_ON_REJECT(x, p);
+      return -1;
+    }
+    case BUCKETSEARCH_SCAN:
+      BS_ON_BUCKET(x, p);
+      hi = start[p + 1] & BUCKETSEARCH_TAG_MASK;
+      BS_ON_SEARCH(x, p, hi - lo);
+      i = lower_bound_scan_u64(a, lo, hi, x);
+      break;
+    default:
+      BS_ON_BUCKET(x, p);
+      hi = start[p + 1] & BUCKETSEARCH_TAG_MASK;
+      if (x < a[lo] || x > a[hi - 1]) { BS_ON_REJECT(x, p); return -1; }
+      BS_ON_SEARCH(x, p, hi - lo);
+      i = lower_bound_branchless_u64(a, lo, hi, x);
+      break;
+  }
+  if (i != hi && a[i] == x) return lookup_result(x, (ptrdiff_t)i);
+  return -1;
+}
+
+// ---------------- equi-depth sampled directory ----------------
+
+size_t bucketsearch_u64_sample_count(size_t n, uint32_t m) {
+  if (m == 0) return 0;
+  return n / m + (n % m != 0);
+}
+
+int bucketsearch_u64_build_sample(const uint64_t *a, size_t n, uint32_t m, uint64_t *sample) {
+  if (!sample) return -1;
+  if (m == 0) return -2;
+  size_t cnt = bucketsearch_u64_sample_count(n, m);
+  for (size_t j = 0; j < cnt; j++) sample[j] = a[j * m];
+  return 0;
+}
+
+ptrdiff_t bucketsearch_u64_find_sample(const uint64_t *a, size_t n, uint32_t m,
+                                       const uint64_t *sample, uint64_t x) {
+  if (!a || !sample || n == 0 || m == 0) return -1;
+  size_t cnt = bucketsearch_u64_sample_count(n, m);
+
+  // j = samples < x; the sample is small enough to stay cache resident
+  size_t j = lower_bound_branchless_u64(sample, 0, cnt, x);
+  if (j == 0) return (a[0] == x) ? 0 : -1;
+
+  // a[(j-1)*m] < x <= a[j*m], so the lower bound is in ((j-1)*m, j*m]
+  size_t lo = (j - 1) * (size_t)m + 1;
+  size_t hi = j * (size_t)m < n ? j * (size_t)m : n;
 
+  size_t i = (m <= BUCKETSEARCH_SCAN_MAX) ? lower_bound_scan_u64(a, lo, hi, x)
+                                          : lower_bound_branchless_u64(a, lo - 1, hi, x);
+  if (i != n && a[i] == x) return (ptrdiff_t)i;
+  return -1;
+}
+
+// ---------------- adaptive refinement ----------------
+
+#define ADAPTIVE_PER_PASS 16
+#define ADAPTIVE_MIN_BUCKET 64
+
+// Prefix table over a[lo..hi) on bits [shift, shift + sK) of each key.
+static void build_sub_table(const uint64_t *a, size_t lo, size_t hi,
+                            uint32_t shift, uint32_t sK, size_t *out) {
+  const uint32_t S = 1u << sK;
+  const uint64_t mask = (uint64_t)S - 1;
+  for (uint32_t q = 0; q <= S; q++) out[q] = hi;
+  for (size_t i = lo; i < hi; i++) {
+    uint32_t q = (uint32_t)((a[i] >> shift) & mask);
+    if (out[q] == hi) out[q] = i;
+  }
+  size_t last = hi;
+  for (int32_t q = (int32_t)S - 1; q >= 0; q--) {
+    if (out[q] == hi) out[q] = last;
+    else last = out[q];
+  }
+}
+
+// Probes bucket p costs: the observed depth for a plain bucket; for a
+// refined one, the plain search its traffic would go back to if evicted.
+static inline uint64_t adaptive_score(const bucketsearch_u64_adaptive *ix, uint32_t p) {
+  if (!ix->sub[p]) return ix->probes[p];
+  return (uint64_t)ix->hits[p] * bit_width_u64(ix->start[p + 1] - ix->start[p]);
+}
+
+int bucketsearch_u64_adaptive_init(bucketsearch_u64_adaptive *ix,
+                                   const uint64_t *a, size_t n,
+                                   uint32_t K, uint32_t sub_K, uint32_t max_sub,
+                                   uint64_t refine_every) {
+  if (!ix || (n && !a)) return -1;
+  if (K == 0 || K > 24 || sub_K > 24) return -2;
+  const uint32_t B = 1u << K;
+
+  ix->a = a;
+  ix->n = n;
+  ix->K = K;
+  ix->W = bit_width_u64(n ? a[n - 1] : 0);
+  // sub-tables index the bits right below the K-bit prefix
+  ix->sub_K = (ix->W > K) ? ((ix->W - K < sub_K) ? ix->W - K : sub_K) : 0;
+  ix->sub_shift = (ix->W > K) ? ix->W - K - ix->sub_K : 0;
+  ix->nsub = 0;
+  ix->max_sub = max_sub;
+  ix->queries = 0;
+  ix->refine_every = refine_every;
+  ix->min_bucket = ADAPTIVE_MIN_BUCKET;
+
+  ix->start = (size_t*)malloc((B + 1) * sizeof(size_t));
+  ix->sub = (size_t**)calloc(B, sizeof(size_t*));
+  ix->hits = (uint32_t*)calloc(B, sizeof(uint32_t));
+  ix->probes = (uint32_t*)calloc(B, sizeof(uint32_t));
+  if (!ix->start || !ix->sub || !ix->hits || !ix->probes) {
+    bucketsearch_u64_adaptive_free(ix);
+    return -3;
+  }
+  return bucketsearch_u64_build(a, n, K, ix->start);
+}
+
+void bucketsearch_u64_adaptive_free(bucketsearch_u64_adaptive *ix) {
+  if (!ix) return;
+  if (ix->sub) {
+    for (uint32_t p = 0; p < (1u << ix->K); p++) free(ix->sub[p]);
+  }
+  free(ix->start);
+  free(ix->sub);
+  free(ix->hits);
+  free(ix->probes);
+  ix->start = NULL;
+  ix->sub = NULL;
+  ix->hits = NULL;
+  ix->probes = NULL;
+  ix->nsub = 0;
+}
+
+int bucketsearch_u64_adaptive_refine(bucketsearch_u64_adaptive *ix) {
+  if (!ix || !ix->start) return -1;
+  const uint32_t B = 1u << ix->K;
+  int built = 0;
+
+  if (ix->sub_K > 0 && ix->max_sub > 0) {
+    // top ADAPTIVE_PER_PASS unrefined buckets by score, best first
+    uint32_t cand[ADAPTIVE_PER_PASS];
+    uint64_t cscore[ADAPTIVE_PER_PASS];
+    uint32_t nc = 0;
+    for (uint32_t p = 0; p < B; p++) {
+      if (ix->sub[p] || ix->start[p + 1] - ix->start[p] < ix->min_bucket) continue;
+      uint64_t sc = adaptive_score(ix, p);
+      if (sc == 0 || (nc == ADAPTIVE_PER_PASS && sc <= cscore[nc - 1])) continue;
+      uint32_t j = (nc < ADAPTIVE_PER_PASS) ? nc++ : nc - 1;
+      while (j > 0 && cscore[j - 1] < sc) {
+        cand[j] = cand[j - 1];
+        cscore[j] = cscore[j - 1];
+        j--;
+      }
+      cand[j] = p;
+      cscore[j] = sc;
+    }
+
+    for (uint32_t c = 0; c < nc; c++) {
+      if (ix->nsub >= ix->max_sub) {
+        // full: evict the coldest refined bucket if the candidate is hotter
+        uint32_t victim = B;
+        uint64_t vscore = 0;
+        for (uint32_t p = 0; p < B; p++) {
+          if (!ix->sub[p]) continue;
+          uint64_t sc = adaptive_score(ix, p);
+          if (victim == B || sc < vscore) { victim = p; vscore = sc; }
+        }
+        if (victim == B || vscore >= cscore[c]) break;
+        free(ix->sub[victim]);
+        ix->sub[victim] = NULL;
+        ix->nsub--;
+      }
+      uint32_t p = cand[c];
+      size_t *t = (size_t*)malloc((((size_t)1 << ix->sub_K) + 1) * sizeof(size_t));
+      if (!t) return -3;
+      build_sub_table(ix->a, ix->start[p], ix->start[p + 1], ix->sub_shift, ix->sub_K, t);
+      ix->sub[p] = t;
+      ix->nsub++;
+      built++;
+    }
+  }
+
+  // decay so old traffic fades out
+  for (uint32_t p = 0; p < B; p++) {
+    ix->hits[p] >>= 1;
+    ix->probes[p] >>= 1;
+  }
+  return built;
+}
+
+ptrdiff_t bucketsearch_u64_adaptive_find(bucketsearch_u64_adaptive *ix, uint64_t x) {
+  if (!ix || !ix->start || ix->n == 0) return -1;
+  const uint64_t *a = ix->a;
+  const uint32_t B = 1u << ix->K;
+
+  BS_ON_LOOKUP(x);
+  uint32_t p = prefix_u64(x, ix->W, ix->K);
+  if (p >= B) { BS_ON_REJECT(x, p); return -1; }
+
+  size_t lo = ix->start[p];
+  size_t hi = ix->start[p + 1];
+  if (lo == hi) { BS_ON_EMPTY(x, p); return -1; }
+  BS_ON_BUCKET(x, p);
+
+  if (x < a[lo] || x > a[hi - 1]) { BS_ON_REJECT(x, p); return -1; }
+
+  const size_t *t = ix->sub[p];
+  if (t) {
+    uint32_t q = (uint32_t)((x >> ix->sub_shift) & (((uint64_t)1 << ix->sub_K) - 1));
+    lo = t[q];
+    hi = t[q + 1];
+  }
+
+  if (ix->hits[p] != UINT32_MAX) ix->hits[p]++;
+  uint32_t depth = bit_width_u64(hi - lo);
+  ix->probes[p] = (ix->probes[p] > UINT32_MAX - depth) ? UINT32_MAX : ix->probes[p] + depth;
+
+  BS_ON_SEARCH(x, p, hi - lo);
   size_t i = lower_bound_u64(a, lo, hi, x);
-  if (i != hi && a[i] == x) return (ptrdiff_t)i;
+  ptrdiff_t r = lookup_result(x, (i != hi && a[i] == x) ? (ptrdiff_t)i : -1);
+
+  if (ix->refine_every && ++ix->queries >= ix->refine_every) {
+    ix->queries = 0;
+    bucketsearch_u64_adaptive_refine(ix);
+  }
+  return r;
+}
+
+// ---------------- lazy directory ----------------
+
+int bucketsearch_u64_lazy_init(bucketsearch_u64_lazy *ix, const uint64_t *a, size_t n,
+                               uint32_t K1, uint32_t K2) {
+  if (!ix || (n && !a)) return -1;
+  if (K1 == 0 || K1 > 24 || K2 > 16 || K1 + K2 > 24) return -2;  // prefixes are 32-bit
+  const uint32_t T = 1u << K1;
+  const uint32_t K = K1 + K2;
+
+  ix->a = a;
+  ix->n = n;
+  ix->K1 = K1;
+  ix->K2 = K2;
+  ix->W = bit_width_u64(n ? a[n - 1] : 0);
+  ix->top = (size_t*)malloc((T + 1) * sizeof(size_t));
+  ix->leaf = (size_t**)calloc(T, sizeof(size_t*));
+  if (!ix->top || !ix->leaf) {
+    bucketsearch_u64_lazy_free(ix);
+    return -3;
+  }
+
+  // each boundary narrows the range for the next one
+  size_t lo = 0;
+  for (uint32_t t = 0; t < T; t++) {
+    lo = lower_bound_u64(a, lo, n, prefix_floor_u64(t << K2, ix->W, K));
+    ix->top[t] = lo;
+  }
+  ix->top[T] = n;
+  return 0;
+}
+
+void bucketsearch_u64_lazy_free(bucketsearch_u64_lazy *ix) {
+  if (!ix) return;
+  if (ix->leaf) {
+    for (uint32_t t = 0; t < (1u << ix->K1); t++) free(ix->leaf[t]);
+  }
+  free(ix->top);
+  free(ix->leaf);
+  ix->top = NULL;
+  ix->leaf = NULL;
+}
+
+// Boundaries of top bucket t, computed once; NULL only if allocation fails.
+static const size_t *lazy_leaf(bucketsearch_u64_lazy *ix, uint32_t t) {
+  size_t *l = BS_LOAD_ACQUIRE(&ix->leaf[t]);
+  if (l) return l;
+
+  const uint32_t S = 1u << ix->K2;
+  const uint32_t K = ix->K1 + ix->K2;
+  size_t *fresh = (size_t*)malloc((S + 1) * sizeof(size_t));
+  if (!fresh) return NULL;
+
+  size_t lo = ix->top[t];
+  size_t hi = ix->top[t + 1];
+  fresh[0] = lo;
+  for (uint32_t s = 1; s < S; s++) {
+    lo = lower_bound_u64(ix->a, lo, hi, prefix_floor_u64((t << ix->K2) | s, ix->W, K));
+    fresh[s] = lo;
+  }
+  fresh[S] = hi;
+
+  // another thread may have published first; its table is identical
+  if (BS_CAS_PUBLISH(&ix->leaf[t], &l, fresh)) return fresh;
+  free(fresh);
+  return l;
+}
+
+ptrdiff_t bucketsearch_u64_lazy_find(bucketsearch_u64_lazy *ix, uint64_t x) {
+  if (!ix || !ix->top || ix->n == 0) return -1;
+  const uint64_t *a = ix->a;
+  const uint32_t K = ix->K1 + ix->K2;
+
+  BS_ON_LOOKUP(x);
+  uint32_t p = prefix_u64(x, ix->W, K);
+  if (p >= (1u << K)) { BS_ON_REJECT(x, p); return -1; }
+
+  uint32_t t = p >> ix->K2;
+  size_t lo = ix->top[t];
+  size_t hi = ix->top[t + 1];
+  if (lo == hi) { BS_ON_EMPTY(x, p); return -1; }
+
+  const size_t *l = lazy_leaf(ix, t);
+  if (l) {
+    uint32_t s = p & ((1u << ix->K2) - 1);
+    lo = l[s];
+    hi = l[s + 1];
+    if (lo == hi) { BS_ON_EMPTY(x, p); return -1; }
+  }
+  BS_ON_BUCKET(x, p);
+
+  if (x < a[lo] || x > a[hi - 1]) { BS_ON_REJECT(x, p); return -1; }
+
+  BS_ON_SEARCH(x, p, hi - lo);
+  size_t i = lower_bound_u64(a, lo, hi, x);
+  if (i != hi && a[i] == x) return lookup_result(x, (ptrdiff_t)i);
   return -1;
 }
 
+// ---------------- row-oriented (strided) keys ----------------
+
+static inline uint64_t row_key(const unsigned char *base, size_t i, size_t stride, size_t off) {
+  uint64_t k;
+  memcpy(&k, base + i * stride + off, sizeof(k));
+  return k;
+}
+
+int bucketsearch_u64_build_rows(const void *base, size_t n, size_t stride, size_t key_off,
+                                uint32_t K, size_t *start) {
+  if (!start || (n && !base)) return -1;
+  if (K == 0 || K > 24) return -2;
+  if (stride < key_off + sizeof(uint64_t)) return -3;
+  const unsigned char *b = (const unsigned char*)base;
+  const uint32_t B = 1u << K;
+
+  uint32_t W = bit_width_u64(n ? row_key(b, n - 1, stride, key_off) : 0);
+
+  for (uint32_t p = 0; p <= B; p++) start[p] = n;
+
+  for (size_t i = 0; i < n; i++) {
+    uint32_t p = prefix_u64(row_key(b, i, stride, key_off), W, K);
+    if (start[p] == n) start[p] = i;
+  }
+  start[B] = n;
+
+  size_t last = n;
+  for (int32_t p = (int32_t)B - 1; p >= 0; p--) {
+    if (start[p] == n) start[p] = last;
+    else last = start[p];
+  }
+  return 0;
+}
+
+// Inlined with a constant stride at each call site below.
+static inline ptrdiff_t find_rows_impl(const unsigned char *b, size_t n, size_t stride, size_t off,
+                                       uint32_t K, const size_t *start, uint64_t x) {
+  const uint32_t B = 1u << K;
+  uint32_t W = bit_width_u64(row_key(b, n - 1, stride, off));
+
+  BS_ON_LOOKUP(x);
+  uint32_t p = prefix_u64(x, W, K);
+  if (p >= B) { BS_ON_REJECT(x, p); return -1; }
+
+  size_t lo = start[p];
+  size_t hi = start[p + 1];
+  if (lo == hi) { BS_ON_EMPTY(x, p); return -1; }
+  BS_ON_BUCKET(x, p);
+
+  if (x < row_key(b, lo, stride, off) || x > row_key(b, hi - 1, stride, off)) {
+    BS_ON_REJECT(x, p);
+    return -1;
+  }
+
+  BS_ON_SEARCH(x, p, hi - lo);
+  while (lo < hi) {
+    size_t mid = lo + ((hi - lo) >> 1);
+    if (row_key(b, mid, stride, off) < x) lo = mid + 1;
+    else hi = mid;
+  }
+  if (lo != start[p + 1] && row_key(b, lo, stride, off) == x) return lookup_result(x, (ptrdiff_t)lo);
+  return -1;
+}
+
+ptrdiff_t bucketsearch_u64_find_rows(const void *base, size_t n, size_t stride, size_t key_off,
+                                     uint32_t K, const size_t *start, uint64_t x) {
+  if (!base || !start || n == 0) return -1;
+  if (K == 0 || K > 24) return -1;
+  if (stride < key_off + sizeof(uint64_t)) return -1;   // key would overrun its row
+  const unsigned char *b = (const unsigned char*)base;
+  switch (stride) {
+    case 8:  return find_rows_impl(b, n, 8,  key_off, K, start, x);
+    case 16: return find_rows_impl(b, n, 16, key_off, K, start, x);
+    case 24: return find_rows_impl(b, n, 24, key_off, K, start, x);
+    case 32: return find_rows_impl(b, n, 32, key_off, K, start, x);
+    case 48: return find_rows_impl(b, n, 48, key_off, K, start, x);
+    case 64: return find_rows_impl(b, n, 64, key_off, K, start, x);
+    default: return find_rows_impl(b, n, stride, key_off, K, start, x);
+  }
+}
+
+// ---------------- sampled access heatmap ----------------
+
+int bucketsearch_u64_heatmap_init(bucketsearch_u64_heatmap *hm, uint32_t K, uint32_t period) {
+  if (!hm) return -1;
+  if (K == 0 || K > 24 || period == 0) return -2;
+  const uint32_t B = 1u << K;
+  hm->K = K;
+  hm->period = period;
+  hm->countdown = period;
+  hm->sampled = 0;
+  hm->hits = (uint32_t*)calloc(B, sizeof(uint32_t));
+  hm->found = (uint32_t*)calloc(B, sizeof(uint32_t));
+  hm->depth = (uint32_t*)calloc(B, sizeof(uint32_t));
+  if (!hm->hits || !hm->found || !hm->depth) {
+    bucketsearch_u64_heatmap_free(hm);
+    return -3;
+  }
+  return 0;
+}
+
+void bucketsearch_u64_heatmap_reset(bucketsearch_u64_heatmap *hm) {
+  if (!hm || !hm->hits) return;
+  const size_t B = (size_t)1 << hm->K;
+  memset(hm->hits, 0, B * sizeof(uint32_t));
+  memset(hm->found, 0, B * sizeof(uint32_t));
+  memset(hm->depth, 0, B * sizeof(uint32_t));
+  hm->countdown = hm->period;
+  hm->sampled = 0;
+}
+
+void bucketsearch_u64_heatmap_free(bucketsearch_u64_heatmap *hm) {
+  if (!hm) return;
+  free(hm->hits);
+  free(hm->found);
+  free(hm->depth);
+  hm->hits = hm->found = hm->depth = NULL;
+}
+
+static inline void heat_add(uint32_t *c, uint32_t v) {
+  *c = (*c > UINT32_MAX - v) ? UINT32_MAX : *c + v;
+}
+
+ptrdiff_t bucketsearch_u64_find_heatmap(const uint64_t *a, size_t n,
+                                        uint32_t K, const size_t *start,
+                                        bucketsearch_u64_heatmap *hm, uint64_t x) {
+  if (!hm || !hm->hits || hm->K != K || --hm->countdown != 0) {
+    return bucketsearch_u64_find(a, n, K, start, x);
+  }
+  hm->countdown = hm->period;
+  hm->sampled++;
+  if (!a || !start || n == 0) return -1;
+
+  uint32_t W = bit_width_u64(a[n - 1]);
+  uint32_t p = prefix_u64(x, W, K);
+  if (p >= (1u << K)) return -1;   // above every key: no bucket to charge
+
+  heat_add(&hm->hits[p], 1);
+  size_t lo = start[p];
+  size_t hi = start[p + 1];
+  if (lo == hi || x < a[lo] || x > a[hi - 1]) return -1;
+
+  heat_add(&hm->depth[p], bit_width_u64(hi - lo));
+  size_t i = lower_bound_u64(a, lo, hi, x);
+  if (i != hi && a[i] == x) {
+    heat_add(&hm->found[p], 1);
+    return (ptrdiff_t)i;
+  }
+  return -1;
+}
+
+int bucketsearch_u64_heatmap_write_csv(const bucketsearch_u64_heatmap *hm, const size_t *start, FILE *f) {
+  if (!hm || !hm->hits || !start || !f) return -1;
+  const uint32_t B = 1u << hm->K;
+  fprintf(f, "bucket,keys,hits,found,depth_sum\n");
+  for (uint32_t p = 0; p < B; p++) {
+    if (!hm->hits[p]) continue;
+    fprintf(f, "%u,%zu,%u,%u,%u\n", p, start[p + 1] - start[p],
+            hm->hits[p], hm->found[p], hm->depth[p]);
+  }
+  return ferror(f) ? -2 : 0;
+}
+
+int bucketsearch_u64_heatmap_write_bin(const bucketsearch_u64_heatmap *hm, const size_t *start, FILE *f) {
+  if (!hm || !hm->hits || !start || !f) return -1;
+  const uint32_t B = 1u << hm->K;
+  uint64_t records = 0;
+  for (uint32_t p = 0; p < B; p++) records += (hm->hits[p] != 0);
+
+  uint32_t head[4] = { 0, 1, hm->K, hm->period };
+  memcpy(&head[0], "BSHM", 4);
+  uint64_t counts[2] = { hm->sampled, records };
+  fwrite(head, sizeof(head), 1, f);
+  fwrite(counts, sizeof(counts), 1, f);
+  for (uint32_t p = 0; p < B; p++) {
+    if (!hm->hits[p]) continue;
+    uint32_t r[4] = { p, hm->hits[p], hm->found[p], hm->depth[p] };
+    uint64_t keys = (uint64_t)(start[p + 1] - start[p]);
+    fwrite(r, sizeof(r), 1, f);
+    fwrite(&keys, sizeof(keys), 1, f);
+  }
+  return ferror(f) ? -2 : 0;
+}
+
+// ---------------- batch planner ----------------
+
+// Cost model constants, ns. Fitted to measured ns/query of each strategy
+// over n = 1M..50M, batches of 1K..1M random, sorted, 90%-sorted and
+// repeated queries; only their ratios matter.
+#define PLAN_HIT_NS      1.0    // cache line from cache
+#define PLAN_MISS_NS     80.0   // cache line from DRAM
+#define PLAN_MLP         4.0    // misses in flight under prefetch / streaming
+#define PLAN_SCATTER_NS  5.0    // partition, gather and scatter back, per query
+#define PLAN_BRANCH_NS   5.0    // mispredicted branch
+#define PLAN_OVERLAP     0.85   // find_batch compute vs one lookup at a time
+#define PLAN_SAMPLE      256
+#define PLAN_CACHE       ((size_t)8 << 20)
+#define PLAN_TLB_REACH   ((size_t)8 << 20)   // bytes of pages the TLB maps
+#define PLAN_MIN_PART    64     // queries per partition worth a pass
+#define PLAN_MAX_BITS    12
+
+// Share of accesses to a working set of ws bytes that miss a cache of c bytes.
+static double plan_miss(double ws, double c) {
+  return ws > c ? 1.0 - c / ws : 0.0;
+}
+
+int bucketsearch_u64_plan_batch(const uint64_t *a, size_t n, uint32_t K, const size_t *start,
+                                const uint64_t *xs, size_t m, size_t cache_bytes,
+                                bucketsearch_u64_plan *plan) {
+  if (!plan || (m && !xs)) return -1;
+  if (K == 0 || K > 24) return -2;
+  if (!cache_bytes) cache_bytes = PLAN_CACHE;
+  memset(plan, 0, sizeof(*plan));
+  plan->strategy = BUCKETSEARCH_PLAN_SCALAR;
+  if (!a || !start || n == 0 || m == 0) return 0;
+  const uint32_t B = 1u << K;
+
+  // sample: evenly spaced queries and their right neighbours
+  uint64_t s[PLAN_SAMPLE];
+  size_t cnt = m < PLAN_SAMPLE ? m : PLAN_SAMPLE, asc = 0, eq = 0, pairs = 0;
+  for (size_t k = 0; k < cnt; k++) {
+    size_t i = (size_t)((double)k * (double)m / (double)cnt);
+    s[k] = xs[i];
+    if (i + 1 < m) {
+      asc += xs[i] <= xs[i + 1];
+      eq += xs[i] == xs[i + 1];
+      pairs++;
+    }
+  }
+  for (size_t k = 1; k < cnt; k++) {
+    uint64_t v = s[k];
+    size_t j = k;
+    for (; j > 0 && s[j - 1] > v; j--) s[j] = s[j - 1];
+    s[j] = v;
+  }
+  // distinct queries in the batch: Chao1 from the sample's singletons and
+  // doubletons, capped by scaling up the sample's distinct count
+  size_t seen = 0, f1 = 0, f2 = 0;
+  for (size_t k = 0; k < cnt;) {
+    size_t e = k + 1;
+    while (e < cnt && s[e] == s[k]) e++;
+    seen++;
+    f1 += (e - k == 1);
+    f2 += (e - k == 2);
+    k = e;
+  }
+  double distinct = (double)m * (double)seen / (double)cnt;
+  if (f2) {
+    double chao = (double)seen + (double)f1 * (double)f1 / (2.0 * (double)f2);
+    if (chao < distinct) distinct = chao;
+  }
+  // a query equal to its neighbour is a repeat; in a sorted batch of long
+  // runs the spaced sample sees only distinct keys, but the neighbours do not
+  double adjacent = pairs ? (double)eq / (double)pairs : 0.0;
+  if (distinct > (double)m * (1.0 - adjacent)) distinct = (double)m * (1.0 - adjacent);
+  if (distinct < 1.0) distinct = 1.0;
+  plan->sorted = pairs ? (double)asc / (double)pairs : 1.0;
+  plan->dups = 1.0 - distinct / (double)m;
+  int sorted = plan->sorted >= 0.95;
+
+  // cache lines a lookup can miss: start[p], then probes past the first line
+  double per_bucket = (double)n / (double)B;
+  double lines = 2.0 + (per_bucket > 8.0 ? (double)bit_width_u64((uint64_t)(per_bucket / 8.0)) : 0.0);
+  double footprint = (double)n * sizeof(uint64_t) + (double)(B + 1) * sizeof(size_t);
+  // ascending queries only touch lines their predecessor did not
+  double gap = (double)n / distinct;
+  double fresh = (gap * sizeof(uint64_t) + (double)B / distinct * sizeof(size_t)) / 64.0;
+  double qlines = sorted && fresh < lines ? fresh : lines;
+
+  // misses per query: first touch of each distinct line (cached from earlier
+  // batches only as far as the whole index fits), plus re-touches evicted
+  // within the batch when its own working set spills
+  double uniq = distinct * qlines < footprint / 64.0 ? distinct * qlines : footprint / 64.0;
+  double ws = uniq * 64.0;
+  double first = uniq * plan_miss(footprint, (double)cache_bytes);
+  double again = (double)m * qlines - uniq;
+  if (again < 0) again = 0;
+  double miss = (first + again * plan_miss(ws, (double)cache_bytes)) / (double)m;
+
+  // in-bucket binary search: one compare and half a mispredict per step;
+  // find_batch overlaps independent lookups, and their first two misses
+  double steps = (double)bit_width_u64((uint64_t)per_bucket);
+  double cpu = PLAN_HIT_NS * (1.0 + steps) + PLAN_BRANCH_NS * steps / 2;
+  double exposed = sorted ? 1.0 / PLAN_MLP : (2.0 / PLAN_MLP + lines - 2.0) / lines;
+
+  plan->cost[BUCKETSEARCH_PLAN_SCALAR] = cpu + PLAN_MISS_NS * miss;
+  plan->cost[BUCKETSEARCH_PLAN_PREFETCH] = m < BATCH_GROUP
+      ? plan->cost[BUCKETSEARCH_PLAN_SCALAR] + 1.0
+      : cpu * PLAN_OVERLAP + PLAN_MISS_NS * miss * exposed;
+
+  // partitions: enough that one part's share of the working set fits half
+  // the cache and the TLB's reach, so re-touches within a part hit both
+  double part_ws = (double)cache_bytes / 2 < (double)PLAN_TLB_REACH
+      ? (double)cache_bytes / 2 : (double)PLAN_TLB_REACH;
+  uint32_t R = 0;
+  while (!sorted && R < K && R < PLAN_MAX_BITS &&
+         ws / (double)((size_t)1 << R) > part_ws &&
+         (m >> (R + 1)) >= PLAN_MIN_PART) R++;
+  if (R == 0) {
+    plan->cost[BUCKETSEARCH_PLAN_PARTITION] = HUGE_VAL;
+  } else {
+    double ws_p = ws / (double)((size_t)1 << R);
+    double miss_p = (first + again * plan_miss(ws_p, (double)cache_bytes)) / (double)m;
+    plan->cost[BUCKETSEARCH_PLAN_PARTITION] = PLAN_SCATTER_NS + cpu * PLAN_OVERLAP +
+        PLAN_MISS_NS * miss_p * exposed;
+    plan->partition_bits = R;
+  }
+
+  // merge walk: the gallop covers at most the gap to the previous answer
+  // or the bucket, whichever is shorter; misses stream; repeats are free.
+  // Each descent restarts the walk, so out-of-order queries cost a lookup.
+  if (plan->sorted < 0.5) {
+    plan->cost[BUCKETSEARCH_PLAN_MERGE] = HUGE_VAL;
+  } else {
+    double d = (double)bit_width_u64((uint64_t)(gap < per_bucket ? gap : per_bucket));
+    double step = PLAN_HIT_NS * (1.0 + d) + PLAN_BRANCH_NS * d / 2;
+    double per_distinct = step + PLAN_MISS_NS * miss / PLAN_MLP * (double)m / distinct;
+    plan->cost[BUCKETSEARCH_PLAN_MERGE] =
+        (1.0 - plan->dups) * per_distinct + plan->dups * PLAN_HIT_NS +
+        (1.0 - plan->sorted) * plan->cost[BUCKETSEARCH_PLAN_SCALAR];
+  }
+
+  for (int k = 1; k < 4; k++) {
+    if (plan->cost[k] < plan->cost[plan->strategy]) plan->strategy = k;
+  }
+  return 0;
+}
+
+// Forward walk over ascending queries; a descent restarts from a[0].
+static void find_merge(const uint64_t *a, size_t n, uint32_t K, const size_t *start,
+                       const uint64_t *xs, size_t m, ptrdiff_t *out) {
+  const uint32_t B = 1u << K;
+  const uint32_t W = bit_width_u64(a[n - 1]);
+  size_t pos = 0;   // lower bound of the previous query
+  for (size_t j = 0; j < m; j++) {
+    uint64_t x = xs[j];
+    if (j && x < xs[j - 1]) pos = 0;
+    out[j] = -1;
+    BS_ON_LOOKUP(x);
+    uint32_t p = prefix_u64(x, W, K);
+    if (p >= B) { BS_ON_REJECT(x, p); continue; }
+    size_t lo = start[p], hi = start[p + 1];
+    if (lo == hi) { BS_ON_EMPTY(x, p); continue; }
+    BS_ON_BUCKET(x, p);
+    if (x < a[lo] || x > a[hi - 1]) { BS_ON_REJECT(x, p); continue; }
+    if (pos > lo) lo = pos;
+    BS_ON_SEARCH(x, p, hi - lo);
+    size_t i = gallop_lower_bound_u64(a, lo, hi, x);
+    pos = i;
+    if (a[i] == x) out[j] = lookup_result(x, (ptrdiff_t)i);
+  }
+}
+
+// Counting sort of the queries by the top R bits of their bucket, one
+// find_batch over the reordered keys, results scattered back.
+static int find_partitioned(const uint64_t *a, size_t n, uint32_t K, const size_t *start,
+                            uint32_t R, const uint64_t *xs, size_t m, ptrdiff_t *out) {
+  const uint32_t B = 1u << K;
+  const uint32_t W = bit_width_u64(a[n - 1]);
+  const size_t P = (size_t)1 << R;
+  if (m == 0) return 0;
+  size_t *count = (size_t*)calloc(P + 1, sizeof(size_t));
+  size_t *idx = (size_t*)malloc(m * sizeof(size_t));
+  uint64_t *keys = (uint64_t*)malloc(m * sizeof(uint64_t));
+  ptrdiff_t *res = (ptrdiff_t*)malloc(m * sizeof(ptrdiff_t));
+  if (!count || !idx || !keys || !res) {
+    free(count); free(idx); free(keys); free(res);
+    return -1;
+  }
+  for (size_t j = 0; j < m; j++) {
+    uint32_t p = prefix_u64(xs[j], W, K);
+    count[(p < B ? p : B - 1) >> (K - R)]++;
+  }
+  size_t sum = 0;
+  for (size_t t = 0; t <= P; t++) {
+    size_t c = count[t];
+    count[t] = sum;
+    sum += c;
+  }
+  for (size_t j = 0; j < m; j++) {
+    uint32_t p = prefix_u64(xs[j], W, K);
+    idx[count[(p < B ? p : B - 1) >> (K - R)]++] = j;
+  }
+  for (size_t d = 0; d < m; d++) keys[d] = xs[idx[d]];
+  bucketsearch_u64_find_batch(a, n, K, start, keys, m, res);
+  for (size_t d = 0; d < m; d++) out[idx[d]] = res[d];
+  free(count); free(idx); free(keys); free(res);
+  return 0;
+}
+
+int bucketsearch_u64_find_planned(const uint64_t *a, size_t n, uint32_t K, const size_t *start,
+                                  const bucketsearch_u64_plan *plan,
+                                  const uint64_t *xs, size_t m, ptrdiff_t *out) {
+  if ((m && (!xs || !out)) || K == 0 || K > 24) return -1;
+  bucketsearch_u64_plan local;
+  if (!plan) {
+    if (bucketsearch_u64_plan_batch(a, n, K, start, xs, m, 0, &local) != 0) return -1;
+    plan = &local;
+  }
+  if (!a || !start || n == 0) {
+    for (size_t j = 0; j < m; j++) out[j] = -1;
+    return 0;
+  }
+  switch (plan->strategy) {
+    case BUCKETSEARCH_PLAN_SCALAR:
+      for (size_t j = 0; j < m; j++) out[j] = bucketsearch_u64_find(a, n, K, start, xs[j]);
+      return 0;
+    case BUCKETSEARCH_PLAN_MERGE:
+      find_merge(a, n, K, start, xs, m, out);
+      return 0;
+    case BUCKETSEARCH_PLAN_PARTITION:
+      if (plan->partition_bits >= 1 && plan->partition_bits <= K &&
+          find_partitioned(a, n, K, start, plan->partition_bits, xs, m, out) == 0) return 0;
+      break;
+    default:
+      break;
+  }
+  bucketsearch_u64_find_batch(a, n, K, start, xs, m, out);
+  return 0;
+}
+
+// ---------------- lookup statistics ----------------
+
+int bucketsearch_u64_stats_get(bucketsearch_u64_stats *out) {
+#ifdef BUCKETSEARCH_STATS
+  if (!out) return -1;
+  *out = bs_stats;
+  out->not_found = out->lookups - out->found;
+  return 0;
+#else
+  (void)out;
+  return -1;
+#endif
+}
+
+int bucketsearch_u64_stats_reset(void) {
+#ifdef BUCKETSEARCH_STATS
+  memset(&bs_stats, 0, sizeof(bs_stats));
+  return 0;
+#else
+  return -1;
+#endif
+}
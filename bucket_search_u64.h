@@ -1,6 +1,7 @@
 #pragma once
 #include <stdint.h>
 #include <stddef.h>
+#include <stdio.h>
 
 // Build prefix-bucket start table for sorted array a[0..n).
 // Returns 0 on success, nonzero on error.
@@ -11,3 +12,346 @@ ptrdiff_t bucketsearch_u64_find(const uint64_t *a, size_t n,
                                uint32_t K, const size_t *start,
                                uint64_t x);
 
+// Same table as bucketsearch_u64_build, found by one binary search per
+// bucket boundary (galloping from the previous one) instead of a pass over
+// the keys: O(2^K log(n / 2^K)), cheaper when 2^K is well below n.
+int bucketsearch_u64_build_bounds(const uint64_t *a, size_t n, uint32_t K, size_t *start);
+
+// Building blocks for parallel builds. Slices of one (a, n, K) write
+// disjoint entries of start[], so they can run on separate threads.
+// Keys [lo, hi): writes start[p] for p in (prefix(a[lo-1]), prefix(a[hi-1])],
+// from p = 0 when lo == 0 and through p = 2^K when hi == n.
+// Buckets [p0, p1): writes start[p0..p1), and start[2^K] when p1 == 2^K.
+// Return 0 on success, nonzero on error.
+int bucketsearch_u64_build_keys_slice(const uint64_t *a, size_t n, uint32_t K, size_t *start,
+                                      size_t lo, size_t hi);
+int bucketsearch_u64_build_bounds_slice(const uint64_t *a, size_t n, uint32_t K, size_t *start,
+                                        uint32_t p0, uint32_t p1);
+
+// Building blocks for adapters over other key layouts. The directory puts
+// a W-bit key x in bucket bucketsearch_u64_prefix(x, W, K); bit_width(0) = 1.
+static inline uint32_t bucketsearch_u64_bit_width(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return x ? 64u - (uint32_t)__builtin_clzll(x) : 1u;
+#else
+  uint32_t w = 0;
+  do { w++; x >>= 1; } while (x);
+  return w;
+#endif
+}
+
+static inline uint32_t bucketsearch_u64_prefix(uint64_t x, uint32_t W, uint32_t K) {
+  if (W >= K) return (uint32_t)(x >> (W - K));
+  return (uint32_t)(x << (K - W));
+}
+
+// start[] over n sorted keys given by their buckets: bucket(ctx, i) must be
+// nondecreasing in i and below 2^K.
+// Returns 0 on success, nonzero on error.
+int bucketsearch_u64_build_from(uint32_t (*bucket)(const void *ctx, size_t i), const void *ctx,
+                                size_t n, uint32_t K, size_t *start);
+
+
+// Batched bucketsearch_u64_find: out[j] = index of xs[j] or -1.
+// Queries are processed in groups so directory and key loads of
+// independent queries overlap (software prefetch).
+void bucketsearch_u64_find_batch(const uint64_t *a, size_t n,
+                                 uint32_t K, const size_t *start,
+                                 const uint64_t *xs, size_t m, ptrdiff_t *out);
+
+// Mark buckets whose keys form one unbroken run a[i] = a[lo] + (i - lo).
+// start[] must come from bucketsearch_u64_build with the same K.
+// dense[] is a bitmap of ((1<<K) + 63) / 64 words. When the whole array is
+// one run every non-empty bucket is marked.
+// Returns 0 on success, nonzero on error.
+int bucketsearch_u64_build_dense(const uint64_t *a, size_t n, uint32_t K,
+                                 const size_t *start, uint64_t *dense);
+
+// Same as bucketsearch_u64_find, but a dense bucket is answered with
+// lo + (x - a[lo]) after one range check instead of a search.
+ptrdiff_t bucketsearch_u64_find_dense(const uint64_t *a, size_t n,
+                                      uint32_t K, const size_t *start,
+                                      const uint64_t *dense, uint64_t x);
+
+// Rank bitmap: one bit per value of [a[0], a[n-1]] with a cumulative
+// popcount before every 512-bit block. Strictly increasing keys only.
+typedef struct {
+  uint64_t base;          // a[0]
+  uint64_t span;          // a[n-1] - a[0] + 1 bits in use
+  size_t   n;
+  const uint64_t *rank;   // nblocks + 1 counts
+  const uint64_t *bits;   // 8 words per block
+} bucketsearch_u64_bitmap;
+
+// Universe may be at most this many times n before the bitmap is refused.
+#define BUCKETSEARCH_BITMAP_MAX_SPAN 32
+
+// Returns the number of uint64_t words the bitmap for a[0..n) needs,
+// or 0 when the universe is too sparse for the bitmap to pay off.
+size_t bucketsearch_u64_bitmap_words(const uint64_t *a, size_t n);
+
+// Build the bitmap into words[0..bucketsearch_u64_bitmap_words(a, n)).
+// Returns 0 on success, nonzero on error (too sparse, duplicate or
+// unsorted keys); nothing is written when the keys are out of order.
+int bucketsearch_u64_bitmap_build(const uint64_t *a, size_t n, uint64_t *words,
+                                  bucketsearch_u64_bitmap *bm);
+
+// Returns index i if found, or -1 if not found.
+ptrdiff_t bucketsearch_u64_bitmap_find(const bucketsearch_u64_bitmap *bm, uint64_t x);
+
+// Returns the first index i with a[i] >= x (n if none).
+size_t bucketsearch_u64_bitmap_lower_bound(const bucketsearch_u64_bitmap *bm, uint64_t x);
+
+// Exact-match sidecar: bucketized cuckoo hash from key to index, 4 key/index
+// pairs per 64-byte bucket, two candidate buckets per key. Built next to
+// start[]; range and lower-bound queries keep using the bucket table.
+typedef struct {
+  const uint64_t *slots;  // nbuckets * 8 words, 64-byte aligned
+  size_t   nbuckets;
+  uint64_t seed;
+} bucketsearch_u64_cuckoo;
+
+// Returns the number of uint64_t words to allocate for n keys.
+size_t bucketsearch_u64_cuckoo_words(size_t n);
+
+// Build into words[0..bucketsearch_u64_cuckoo_words(n)). Duplicate keys map
+// to their first index. Returns 0 on success, nonzero on error.
+int bucketsearch_u64_cuckoo_build(const uint64_t *a, size_t n, uint64_t *words,
+                                  bucketsearch_u64_cuckoo *h);
+
+// Returns index i if found, or -1 if not found.
+ptrdiff_t bucketsearch_u64_cuckoo_find(const bucketsearch_u64_cuckoo *h, uint64_t x);
+
+// Per-bucket linear model: position inside bucket p is predicted as
+// (x - a[lo]) * slope, and the true position is within +-err of it.
+typedef struct {
+  float    slope;
+  uint32_t err;       // BUCKETSEARCH_MODEL_ERR_WIDE: search the whole bucket
+} bucketsearch_u64_model;
+
+// err of a bucket whose true error does not fit 32 bits.
+#define BUCKETSEARCH_MODEL_ERR_WIDE UINT32_MAX
+
+// Fit model[0..(1<<K)) from the bucket min/max. start[] must come from
+// bucketsearch_u64_build with the same K.
+// Returns 0 on success, nonzero on error.
+int bucketsearch_u64_build_model(const uint64_t *a, size_t n, uint32_t K,
+                                 const size_t *start, bucketsearch_u64_model *model);
+
+// Same as bucketsearch_u64_find, but only the predicted +-err window of
+// the bucket is searched (all of it for BUCKETSEARCH_MODEL_ERR_WIDE).
+ptrdiff_t bucketsearch_u64_find_model(const uint64_t *a, size_t n,
+                                      uint32_t K, const size_t *start,
+                                      const bucketsearch_u64_model *model,
+                                      uint64_t x);
+
+// Tagged directory: the top 3 bits of start[p] hold the kernel class of
+// bucket p, chosen at build time. Requires n < 2^61 on 64-bit targets.
+// A tagged start[] must only be passed to bucketsearch_u64_find_tagged.
+enum {
+  BUCKETSEARCH_EMPTY  = 0,   // no keys: reject without touching a[]
+  BUCKETSEARCH_SINGLE = 1,   // one key: a single compare
+  BUCKETSEARCH_DENSE  = 2,   // unbroken run: lo + (x - a[lo])
+  BUCKETSEARCH_SCAN   = 3,   // up to BUCKETSEARCH_SCAN_MAX keys: linear count
+  BUCKETSEARCH_WIDE   = 4    // branchless binary search
+};
+
+#define BUCKETSEARCH_SCAN_MAX 16
+#define BUCKETSEARCH_TAG_SHIFT (sizeof(size_t) * 8 - 3)
+#define BUCKETSEARCH_TAG_MASK  (((size_t)1 << BUCKETSEARCH_TAG_SHIFT) - 1)
+
+// Build start[0..(1<<K)] like bucketsearch_u64_build, then tag each bucket.
+// Returns 0 on success, nonzero on error.
+int bucketsearch_u64_build_tagged(const uint64_t *a, size_t n, uint32_t K, size_t *start);
+
+// Returns index i if found, or -1 if not found. Dispatches on the bucket class.
+ptrdiff_t bucketsearch_u64_find_tagged(const uint64_t *a, size_t n,
+                                       uint32_t K, const size_t *start,
+                                       uint64_t x);
+
+// Equi-depth sampled directory: sample[j] = a[j*m]. Every bucket holds
+// exactly m keys whatever the key distribution, so the last-mile search is
+// bounded even where prefix bucketing collapses.
+// Returns the number of sample entries for n keys (ceil(n / m)).
+size_t bucketsearch_u64_sample_count(size_t n, uint32_t m);
+
+// Fill sample[0..bucketsearch_u64_sample_count(n, m)).
+// Returns 0 on success, nonzero on error.
+int bucketsearch_u64_build_sample(const uint64_t *a, size_t n, uint32_t m, uint64_t *sample);
+
+// Returns index i if found, or -1 if not found.
+ptrdiff_t bucketsearch_u64_find_sample(const uint64_t *a, size_t n, uint32_t m,
+                                       const uint64_t *sample, uint64_t x);
+
+// Adaptive index: a coarse prefix table whose hottest large buckets get
+// their own sub-table of sub_K more prefix bits. Lookups count hits and
+// probe depth per bucket; bucketsearch_u64_adaptive_refine (called every
+// refine_every lookups, or by the caller when idle) spends at most max_sub
+// sub-tables on the buckets where lookups cost the most, evicting colder
+// ones, then halves the counters so the index follows a moving window.
+// Lookups update counters and may refine, so an index must not be shared
+// between threads.
+typedef struct {
+  const uint64_t *a;
+  size_t   n;
+  uint32_t K, W;
+  uint32_t sub_K, sub_shift;  // sub_K == 0: keys too narrow to refine
+  size_t   *start;            // (1<<K)+1
+  size_t  **sub;              // per bucket: (1<<sub_K)+1 offsets or NULL
+  uint32_t *hits;             // lookups that reached a search, per bucket
+  uint32_t *probes;           // summed probe depth, per bucket
+  uint32_t  nsub, max_sub;
+  uint64_t  queries, refine_every;
+  size_t    min_bucket;       // smaller buckets are never refined
+} bucketsearch_u64_adaptive;
+
+// Allocate and build the coarse table. refine_every == 0 leaves refinement
+// to explicit bucketsearch_u64_adaptive_refine calls.
+// Returns 0 on success, nonzero on error.
+int bucketsearch_u64_adaptive_init(bucketsearch_u64_adaptive *ix,
+                                   const uint64_t *a, size_t n,
+                                   uint32_t K, uint32_t sub_K, uint32_t max_sub,
+                                   uint64_t refine_every);
+
+void bucketsearch_u64_adaptive_free(bucketsearch_u64_adaptive *ix);
+
+// Returns index i if found, or -1 if not found.
+ptrdiff_t bucketsearch_u64_adaptive_find(bucketsearch_u64_adaptive *ix, uint64_t x);
+
+// Refine the hottest buckets now. Returns the number of sub-tables built,
+// or negative on allocation failure.
+int bucketsearch_u64_adaptive_refine(bucketsearch_u64_adaptive *ix);
+
+// Lazy two-level directory for large (e.g. memory-mapped) arrays where only
+// part of the key space is queried. init computes the 2^K1-entry top level
+// with one boundary binary search per entry; the 2^K2 boundaries inside a
+// top bucket are computed on first touch and published atomically, so
+// concurrent lookups are safe and untouched regions cost nothing.
+typedef struct {
+  const uint64_t *a;
+  size_t   n;
+  uint32_t K1, K2, W;
+  size_t  *top;    // (1<<K1)+1
+  size_t **leaf;   // per top bucket: (1<<K2)+1 offsets or NULL until touched
+} bucketsearch_u64_lazy;
+
+// K1 in [1..24], K2 in [0..16], K1 + K2 <= 24.
+// Returns 0 on success, nonzero on error (-2: K1, K2 out of range).
+int bucketsearch_u64_lazy_init(bucketsearch_u64_lazy *ix, const uint64_t *a, size_t n,
+                               uint32_t K1, uint32_t K2);
+
+// Not safe against concurrent lookups.
+void bucketsearch_u64_lazy_free(bucketsearch_u64_lazy *ix);
+
+// Returns index i if found, or -1 if not found.
+ptrdiff_t bucketsearch_u64_lazy_find(bucketsearch_u64_lazy *ix, uint64_t x);
+
+// Row-oriented data: key i is the uint64_t at (const char*)base + i*stride
+// + key_off (any alignment), rows sorted by key. Strides 8, 16, 24, 32, 48
+// and 64 get specialized lookup loops.
+// Returns 0 on success, nonzero on error.
+int bucketsearch_u64_build_rows(const void *base, size_t n, size_t stride, size_t key_off,
+                                uint32_t K, size_t *start);
+
+// Returns row index i if found, or -1 if not found (also when
+// key_off + 8 > stride).
+ptrdiff_t bucketsearch_u64_find_rows(const void *base, size_t n, size_t stride, size_t key_off,
+                                     uint32_t K, const size_t *start, uint64_t x);
+
+// Sampled access heatmap for a start[] table: every period-th lookup through
+// bucketsearch_u64_find_heatmap records its bucket, whether the key was
+// found, and the depth of its in-bucket search (bit_width of the range, 0
+// when rejected without a search). Counters saturate. Not thread-safe: use
+// one heatmap per thread.
+typedef struct {
+  uint32_t  K;
+  uint32_t  period;     // sample 1 in period lookups
+  uint32_t  countdown;
+  uint64_t  sampled;
+  uint32_t *hits;       // (1<<K) sampled lookups per bucket
+  uint32_t *found;      // (1<<K) of those, key present
+  uint32_t *depth;      // (1<<K) summed search depth
+} bucketsearch_u64_heatmap;
+
+// K in [1..24] (same as the table), period >= 1.
+// Returns 0 on success, nonzero on error.
+int bucketsearch_u64_heatmap_init(bucketsearch_u64_heatmap *hm, uint32_t K, uint32_t period);
+void bucketsearch_u64_heatmap_reset(bucketsearch_u64_heatmap *hm);
+void bucketsearch_u64_heatmap_free(bucketsearch_u64_heatmap *hm);
+
+// Same result as bucketsearch_u64_find; 1 in hm->period calls is recorded.
+ptrdiff_t bucketsearch_u64_find_heatmap(const uint64_t *a, size_t n,
+                                        uint32_t K, const size_t *start,
+                                        bucketsearch_u64_heatmap *hm, uint64_t x);
+
+// Export buckets with at least one sampled lookup; start[] supplies the
+// bucket sizes. CSV: header line, then "bucket,keys,hits,found,depth_sum".
+// Binary (host byte order): "BSHM", uint32 version (1), K, period,
+// uint64 sampled, uint64 record count, then per record uint32 bucket,
+// hits, found, depth_sum and uint64 keys.
+// Returns 0 on success, nonzero on error.
+int bucketsearch_u64_heatmap_write_csv(const bucketsearch_u64_heatmap *hm, const size_t *start, FILE *f);
+int bucketsearch_u64_heatmap_write_bin(const bucketsearch_u64_heatmap *hm, const size_t *start, FILE *f);
+
+// Batch planner: picks how to run one batch from its shape (size, plus the
+// order and duplicate rate estimated from a sample of up to 256 queries and
+// their right neighbours)
+// and the index size, by a rough ns/query cost model per strategy:
+//   SCALAR     bucketsearch_u64_find per query (tiny batches)
+//   PREFETCH   bucketsearch_u64_find_batch
+//   PARTITION  queries radix-partitioned by the top bits of their bucket,
+//              so each part's slice of start[] and a[] fits half of
+//              cache_bytes and the TLB's reach; one find_batch over all the
+//              reordered queries, results scattered back
+//   MERGE      ascending queries: one forward walk that gallops from the
+//              previous answer inside each bucket
+// Every strategy gives the same out[] for any input; the plan only affects
+// speed (MERGE restarts its walk wherever the queries descend).
+enum {
+  BUCKETSEARCH_PLAN_SCALAR,
+  BUCKETSEARCH_PLAN_PREFETCH,
+  BUCKETSEARCH_PLAN_PARTITION,
+  BUCKETSEARCH_PLAN_MERGE
+};
+
+typedef struct {
+  int      strategy;          // BUCKETSEARCH_PLAN_*
+  uint32_t partition_bits;    // PARTITION: 2^bits partitions
+  double   sorted;            // sampled neighbours in ascending order, 0..1
+  double   dups;              // estimated share of repeated queries, 0..1
+  double   cost[4];           // estimated ns/query, indexed by strategy
+} bucketsearch_u64_plan;
+
+// cache_bytes: cache the lookups can count on (0: 8 MiB).
+// Returns 0 on success, nonzero on error.
+int bucketsearch_u64_plan_batch(const uint64_t *a, size_t n, uint32_t K, const size_t *start,
+                                const uint64_t *xs, size_t m, size_t cache_bytes,
+                                bucketsearch_u64_plan *plan);
+
+// out[j] = index of xs[j] or -1, run as plan says (plan == NULL: planned
+// here with the default cache size). PARTITION allocates 24 bytes per
+// query of scratch and falls back to PREFETCH if that fails.
+// Returns 0 on success, nonzero on error.
+int bucketsearch_u64_find_planned(const uint64_t *a, size_t n, uint32_t K, const size_t *start,
+                                  const bucketsearch_u64_plan *plan,
+                                  const uint64_t *xs, size_t m, ptrdiff_t *out);
+
+// Lookup counters of the calling thread. Collected by the directory
+// lookups (find, find_batch, find_planned, find_dense, find_model,
+// find_tagged, find_rows, adaptive_find, lazy_find) only when the library
+// is compiled with -DBUCKETSEARCH_STATS.
+typedef struct {
+  uint64_t lookups;
+  uint64_t dir_hits;        // non-empty bucket reached
+  uint64_t empty_rejects;   // bucket held no keys
+  uint64_t range_rejects;   // outside the bucket's [first, last] or above a[n-1]
+  uint64_t searches;        // in-bucket searches run
+  uint64_t probe_depth;     // sum over searches of bit_width(range searched)
+  uint64_t found;
+  uint64_t not_found;       // lookups - found
+} bucketsearch_u64_stats;
+
+// Copy / clear this thread's counters.
+// Returns 0 on success, -1 if the library was built without BUCKETSEARCH_STATS.
+int bucketsearch_u64_stats_get(bucketsearch_u64_stats *out);
+int bucketsearch_u64_stats_reset(void);
@@ -0,0 +1,113 @@
+#pragma once
+// C++17 BucketSearch over small fixed key sets, usable in constant
+// expressions: the table is built during compilation from a std::array and
+// lookups on constant keys fold away. Same prefix rule as the C API.
+//
+//   constexpr auto ids = bucketsearch::make_bucket_index<4>(
+//       std::array<std::uint64_t, 5>{3, 17, 42, 99, 1000});
+//   static_assert(ids.valid());
+//   static_assert(ids.find(42) == 2);
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#if __cplusplus < 201703L && !(defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+  #error "bucket_search_u64.hpp requires C++17"
+#endif
+
+namespace bucketsearch {
+
+namespace detail {
+
+constexpr std::uint32_t bit_width_u64(std::uint64_t x) {
+  std::uint32_t w = 0;
+  do { w++; x >>= 1; } while (x);
+  return w;
+}
+
+constexpr std::uint32_t prefix_u64(std::uint64_t x, std::uint32_t W, std::uint32_t K) {
+  if (W >= K) return static_cast<std::uint32_t>(x >> (W - K));
+  return static_cast<std::uint32_t>(x << (K - W));
+}
+
+template <typename It, typename T>
+constexpr std::size_t lower_bound(It a, std::size_t lo, std::size_t hi, const T &x) {
+  while (lo < hi) {
+    std::size_t mid = lo + ((hi - lo) >> 1);
+    if (a[mid] < x) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+}  // namespace detail
+
+template <std::size_t N, std::uint32_t K>
+class BucketIndex {
+  static_assert(K >= 1 && K <= 24, "K must be in [1..24]");
+
+ public:
+  static constexpr std::size_t buckets = std::size_t{1} << K;
+
+  // keys must be sorted; check with valid()
+  constexpr explicit BucketIndex(const std::array<std::uint64_t, N> &keys)
+      : keys_(keys), start_{}, W_(detail::bit_width_u64(N ? keys[N - 1] : 0)) {
+    for (std::size_t p = 0; p <= buckets; p++) start_[p] = N;
+    for (std::size_t i = 0; i < N; i++) {
+      std::uint32_t p = detail::prefix_u64(keys_[i], W_, K);
+      if (p < buckets && start_[p] == N) start_[p] = i;  // p >= buckets only if unsorted
+    }
+    std::size_t last = N;
+    for (std::size_t p = buckets; p-- > 0;) {
+      if (start_[p] == N) start_[p] = last;
+      else last = start_[p];
+    }
+  }
+
+  // true if the keys were sorted, i.e. lookups are meaningful
+  constexpr bool valid() const {
+    for (std::size_t i = 1; i < N; i++) {
+      if (keys_[i] < keys_[i - 1]) return false;
+    }
+    return true;
+  }
+
+  // Returns index i if found, or -1 if not found.
+  constexpr std::ptrdiff_t find(std::uint64_t x) const {
+    if (N == 0) return -1;
+    std::uint32_t p = detail::prefix_u64(x, W_, K);
+    if (p >= buckets) return -1;
+    std::size_t lo = start_[p];
+    std::size_t hi = start_[p + 1];
+    if (lo == hi || x < keys_[lo] || x > keys_[hi - 1]) return -1;
+    std::size_t i = detail::lower_bound(keys_.data(), lo, hi, x);
+    return (i != hi && keys_[i] == x) ? static_cast<std::ptrdiff_t>(i) : -1;
+  }
+
+  constexpr bool contains(std::uint64_t x) const { return find(x) >= 0; }
+
+  // First index i with keys[i] >= x (N if none).
+  constexpr std::size_t lower_bound(std::uint64_t x) const {
+    if (N == 0) return 0;
+    if (x > keys_[N - 1]) return N;
+    std::uint32_t p = detail::prefix_u64(x, W_, K);
+    return detail::lower_bound(keys_.data(), start_[p], start_[p + 1], x);
+  }
+
+  constexpr std::size_t size() const { return N; }
+  constexpr const std::array<std::uint64_t, N> &keys() const { return keys_; }
+  constexpr const std::array<std::size_t, buckets + 1> &start() const { return start_; }
+
+ private:
+  std::array<std::uint64_t, N> keys_;
+  std::array<std::size_t, buckets + 1> start_;
+  std::uint32_t W_;
+};
+
+template <std::uint32_t K, std::size_t N>
+constexpr BucketIndex<N, K> make_bucket_index(const std::array<std::uint64_t, N> &keys) {
+  return BucketIndex<N, K>(keys);
+}
+
+}  // namespace bucketsearch
@@ -0,0 +1,119 @@
+#include "bucket_search_u64_arrow.h"
+#include "bucket_search_u64.h"
+
+#include <string.h>
+
+// Key i as an unsigned value whose order matches the column's order.
+static inline uint64_t col_key(const void *v, size_t i, uint32_t width, uint64_t flip) {
+  if (width == 8) return ((const uint64_t*)v)[i] ^ flip;
+  return ((const uint32_t*)v)[i];
+}
+
+static inline uint32_t col_bucket(const bucketsearch_u64_arrow_index *ix, size_t i, uint32_t width) {
+  return bucketsearch_u64_prefix(col_key(ix->values, i, width, ix->flip) - ix->base, ix->W, ix->K);
+}
+
+static uint32_t col_bucket8(const void *ix, size_t i) {
+  return col_bucket((const bucketsearch_u64_arrow_index*)ix, i, 8);
+}
+
+static uint32_t col_bucket4(const void *ix, size_t i) {
+  return col_bucket((const bucketsearch_u64_arrow_index*)ix, i, 4);
+}
+
+static inline int is_valid(const uint8_t *bitmap, int64_t pos) {
+  return (bitmap[pos >> 3] >> (pos & 7)) & 1;
+}
+
+// Returns key width (4 or 8), 0 if unsupported; *is_signed set for int64 types.
+static uint32_t format_width(const char *fmt, int *is_signed) {
+  *is_signed = 0;
+  if (strcmp(fmt, "L") == 0) return 8;
+  if (strcmp(fmt, "I") == 0) return 4;
+  if (strcmp(fmt, "l") == 0) { *is_signed = 1; return 8; }
+  // timestamp: "ts" unit ':' timezone, stored as int64
+  if (fmt[0] == 't' && fmt[1] == 's' && fmt[2] && strchr("smun", fmt[2]) && fmt[3] == ':') {
+    *is_signed = 1;
+    return 8;
+  }
+  return 0;
+}
+
+int bucketsearch_u64_arrow_build(const struct ArrowSchema *schema,
+                                 const struct ArrowArray *array,
+                                 uint32_t K, size_t *start,
+                                 bucketsearch_u64_arrow_index *ix) {
+  if (!schema || !schema->format || !array || !start || !ix) return -1;
+  if (K == 0 || K > 24) return -2;
+  if (schema->dictionary || array->n_buffers != 2 || array->length < 0 || array->offset < 0) return -3;
+
+  int is_signed;
+  uint32_t width = format_width(schema->format, &is_signed);
+  if (width == 0) return -3;
+
+  // Leading and trailing null runs are skipped; a null in between cannot
+  // be indexed without copying.
+  int64_t lo = 0, hi = array->length;
+  const uint8_t *validity = (const uint8_t*)array->buffers[0];
+  if (validity && array->null_count != 0) {
+    while (lo < hi && !is_valid(validity, array->offset + lo)) lo++;
+    while (hi > lo && !is_valid(validity, array->offset + hi - 1)) hi--;
+    for (int64_t i = lo; i < hi; i++) {
+      if (!is_valid(validity, array->offset + i)) return -4;
+    }
+  }
+
+  const unsigned char *buf = (const unsigned char*)array->buffers[1];
+  if (!buf && hi > lo) return -1;
+
+  ix->values = buf ? buf + (size_t)(array->offset + lo) * width : NULL;
+  ix->n = (size_t)(hi - lo);
+  ix->first = (size_t)lo;
+  ix->width = width;
+  ix->K = K;
+  ix->start = start;
+  // sorted signed keys: negative values are all at the front
+  ix->flip = (is_signed && ix->n && (int64_t)((const uint64_t*)ix->values)[0] < 0) ? (1ull << 63) : 0;
+  // bucket by offset from the first key, so a column that starts far from
+  // zero (negatives under the flip, timestamps) still spreads over 2^K
+  ix->base = ix->n ? col_key(ix->values, 0, width, ix->flip) : 0;
+  ix->W = bucketsearch_u64_bit_width(ix->n ? col_key(ix->values, ix->n - 1, width, ix->flip) - ix->base : 0);
+
+  return bucketsearch_u64_build_from(width == 8 ? col_bucket8 : col_bucket4, ix, ix->n, K, start);
+}
+
+// Inlined with a constant width at each call site below; x is already
+// mapped into the column's order.
+static inline ptrdiff_t arrow_find_impl(const bucketsearch_u64_arrow_index *ix,
+                                        uint32_t width, uint64_t x) {
+  const void *v = ix->values;
+  const uint32_t B = 1u << ix->K;
+
+  if (x < ix->base) return -1;
+  uint32_t p = bucketsearch_u64_prefix(x - ix->base, ix->W, ix->K);
+  if (p >= B) return -1;
+
+  size_t lo = ix->start[p];
+  size_t hi = ix->start[p + 1];
+  if (lo == hi) return -1;
+
+  if (x < col_key(v, lo, width, ix->flip) || x > col_key(v, hi - 1, width, ix->flip)) return -1;
+
+  size_t end = hi;
+  while (lo < hi) {
+    size_t mid = lo + ((hi - lo) >> 1);
+    if (col_key(v, mid, width, ix->flip) < x) lo = mid + 1;
+    else hi = mid;
+  }
+  if (lo != end && col_key(v, lo, width, ix->flip) == x) return (ptrdiff_t)(ix->first + lo);
+  return -1;
+}
+
+ptrdiff_t bucketsearch_u64_arrow_find(const bucketsearch_u64_arrow_index *ix, uint64_t x) {
+  if (!ix || !ix->start || ix->n == 0) return -1;
+  if (ix->width == 4) {
+    if (x > UINT32_MAX) return -1;
+    return arrow_find_impl(ix, 4, x);
+  }
+  return arrow_find_impl(ix, 8, x ^ ix->flip);
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Zero-copy BucketSearch over Arrow C Data Interface columns. Only the
+// plain C ABI structs are used; no Arrow library is needed.
+
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+  const char *format;
+  const char *name;
+  const char *metadata;
+  int64_t flags;
+  int64_t n_children;
+  struct ArrowSchema **children;
+  struct ArrowSchema *dictionary;
+  void (*release)(struct ArrowSchema *);
+  void *private_data;
+};
+
+struct ArrowArray {
+  int64_t length;
+  int64_t null_count;
+  int64_t offset;
+  int64_t n_buffers;
+  int64_t n_children;
+  const void **buffers;
+  struct ArrowArray **children;
+  struct ArrowArray *dictionary;
+  void (*release)(struct ArrowArray *);
+  void *private_data;
+};
+
+#endif  // ARROW_C_DATA_INTERFACE
+
+// Index over the non-null run of a sorted column. Supported formats:
+// "L" (uint64), "l" (int64), "I" (uint32) and "ts?:..." timestamps.
+// Nulls are allowed only as a leading and/or trailing run (nulls first /
+// nulls last sort order). Signed columns holding negative values are
+// searched in signed order by flipping the sign bit on the fly. Buckets
+// split the range from the first key to the last, wherever it lies.
+typedef struct {
+  const void *values;   // first indexed value (array offset and leading nulls applied)
+  size_t   n;           // number of indexed values
+  size_t   first;       // logical array index of values[0]
+  uint32_t width;       // key bytes: 4 or 8
+  uint64_t flip;        // XOR applied to keys and queries (1<<63 or 0)
+  uint64_t base;        // first key after the flip; buckets are by offset from it
+  uint32_t W;           // bit width of the last key's offset
+  uint32_t K;
+  size_t  *start;       // caller-provided, (1<<K)+1 entries
+} bucketsearch_u64_arrow_index;
+
+// Build start[] directly over the column buffer; nothing is copied and the
+// array must outlive the index. Returns 0 on success, nonzero on error
+// (-3 unsupported type or keys found out of order, -4 nulls inside the
+// column).
+int bucketsearch_u64_arrow_build(const struct ArrowSchema *schema,
+                                 const struct ArrowArray *array,
+                                 uint32_t K, size_t *start,
+                                 bucketsearch_u64_arrow_index *ix);
+
+// x is the value's bit pattern as uint64_t, e.g. (uint64_t)int64_value.
+// Returns the logical index in the Arrow array if found, or -1 if not found.
+ptrdiff_t bucketsearch_u64_arrow_find(const bucketsearch_u64_arrow_index *ix, uint64_t x);
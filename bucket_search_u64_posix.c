@@ -0,0 +1,281 @@
+#define _DEFAULT_SOURCE
+#include "bucket_search_u64_posix.h"
+#include "bucket_search_u64.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// below this many keys per thread, spawning threads costs more than it saves
+#define PAR_MIN_CHUNK (1u << 20)
+
+static unsigned thread_count(unsigned threads, size_t work) {
+  if (threads == 0) {
+    long c = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = c > 0 ? (unsigned)c : 1u;
+  }
+  size_t cap = work / PAR_MIN_CHUNK;
+  if (cap < 1) cap = 1;
+  return (size_t)threads > cap ? (unsigned)cap : threads;
+}
+
+static int host_is_little_endian(void) {
+  const uint16_t one = 1;
+  return *(const uint8_t*)&one == 1;
+}
+
+// ---------------- sortedness check ----------------
+
+typedef struct {
+  const uint64_t *a;
+  size_t lo, hi;   // checks pairs (i-1, i) for i in [lo, hi)
+  int sorted;
+} sorted_job;
+
+static void *sorted_worker(void *arg) {
+  sorted_job *j = (sorted_job*)arg;
+  int ok = 1;
+  for (size_t i = j->lo; i < j->hi; i++) ok &= (j->a[i - 1] <= j->a[i]);
+  j->sorted = ok;
+  return NULL;
+}
+
+int bucketsearch_u64_is_sorted(const uint64_t *a, size_t n, unsigned threads) {
+  if (n < 2) return 1;
+  unsigned T = thread_count(threads, n);
+
+  sorted_job jobs[64];
+  pthread_t tid[64];
+  if (T > 64) T = 64;
+
+  size_t chunk = (n - 1) / T;
+  for (unsigned t = 0; t < T; t++) {
+    jobs[t].a = a;
+    jobs[t].lo = 1 + t * chunk;
+    jobs[t].hi = (t + 1 == T) ? n : 1 + (t + 1) * chunk;
+    jobs[t].sorted = 1;
+  }
+  // thread 0's share runs on the caller
+  unsigned started = 1;
+  for (unsigned t = 1; t < T; t++, started++) {
+    if (pthread_create(&tid[t], NULL, sorted_worker, &jobs[t]) != 0) break;
+  }
+  for (unsigned t = started; t < T; t++) sorted_worker(&jobs[t]);
+  sorted_worker(&jobs[0]);
+
+  int ok = jobs[0].sorted;
+  for (unsigned t = 1; t < T; t++) {
+    if (t < started) pthread_join(tid[t], NULL);
+    ok &= jobs[t].sorted;
+  }
+  return ok;
+}
+
+// ---------------- parallel build ----------------
+
+typedef struct {
+  const uint64_t *a;
+  size_t n;
+  uint32_t K;
+  size_t *start;
+  int method;
+  size_t lo, hi;   // keys (scan) or buckets (bounds)
+  int rc;
+} build_job;
+
+static void *build_worker(void *arg) {
+  build_job *j = (build_job*)arg;
+  if (j->method == BUCKETSEARCH_BUILD_SCAN)
+    j->rc = bucketsearch_u64_build_keys_slice(j->a, j->n, j->K, j->start, j->lo, j->hi);
+  else
+    j->rc = bucketsearch_u64_build_bounds_slice(j->a, j->n, j->K, j->start,
+                                                (uint32_t)j->lo, (uint32_t)j->hi);
+  return NULL;
+}
+
+int bucketsearch_u64_build_parallel(const uint64_t *a, size_t n, uint32_t K, size_t *start,
+                                    int method, unsigned threads) {
+  if (!start || (n && !a)) return -1;
+  if (K == 0 || K > 24) return -2;
+  if (method != BUCKETSEARCH_BUILD_SCAN && method != BUCKETSEARCH_BUILD_BOUNDS) return -1;
+  const size_t B = (size_t)1 << K;
+  // a boundary search costs about as much as scanning a dozen keys
+  size_t items = (method == BUCKETSEARCH_BUILD_SCAN) ? n : B;
+  unsigned T = thread_count(threads, method == BUCKETSEARCH_BUILD_SCAN ? n : B * 12);
+
+  build_job jobs[64];
+  pthread_t tid[64];
+  if (T > 64) T = 64;
+
+  size_t chunk = items / T;
+  for (unsigned t = 0; t < T; t++) {
+    jobs[t].a = a;
+    jobs[t].n = n;
+    jobs[t].K = K;
+    jobs[t].start = start;
+    jobs[t].method = method;
+    jobs[t].lo = t * chunk;
+    jobs[t].hi = (t + 1 == T) ? items : (t + 1) * chunk;
+    jobs[t].rc = 0;
+  }
+  // thread 0's share runs on the caller
+  unsigned started = 1;
+  for (unsigned t = 1; t < T; t++, started++) {
+    if (pthread_create(&tid[t], NULL, build_worker, &jobs[t]) != 0) break;
+  }
+  for (unsigned t = started; t < T; t++) build_worker(&jobs[t]);
+  build_worker(&jobs[0]);
+
+  int rc = jobs[0].rc;
+  for (unsigned t = 1; t < T; t++) {
+    if (t < started) pthread_join(tid[t], NULL);
+    if (rc == 0) rc = jobs[t].rc;
+  }
+  return rc;
+}
+
+// ---------------- mapping ----------------
+
+static int map_file(const char *path, bucketsearch_u64_mapped *m) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return -2;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    int e = errno;
+    close(fd);
+    errno = e;
+    return -2;
+  }
+  m->map = NULL;
+  m->map_len = (size_t)st.st_size;
+  if (m->map_len) {
+    void *p = mmap(NULL, m->map_len, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+      int e = errno;
+      close(fd);
+      errno = e;
+      return -2;
+    }
+    m->map = p;
+  }
+  close(fd);
+  return 0;
+}
+
+// keys at byte offset off of the mapping; checks alignment and order
+static int attach_keys(bucketsearch_u64_mapped *m, size_t off, size_t n, unsigned threads) {
+  if (n && (((uintptr_t)m->map + off) & 7)) return -3;
+  m->keys = n ? (const uint64_t*)((const unsigned char*)m->map + off) : NULL;
+  m->n = n;
+  if (!bucketsearch_u64_is_sorted(m->keys, n, threads)) return -4;
+  return 0;
+}
+
+int bucketsearch_u64_map_raw(const char *path, unsigned threads, bucketsearch_u64_mapped *m) {
+  if (!path || !m) return -1;
+  memset(m, 0, sizeof(*m));
+  if (!host_is_little_endian()) return -5;
+
+  int rc = map_file(path, m);
+  if (rc != 0) return rc;
+  if (m->map_len % sizeof(uint64_t) != 0) rc = -3;
+  else rc = attach_keys(m, 0, m->map_len / sizeof(uint64_t), threads);
+  if (rc != 0) bucketsearch_u64_unmap(m);
+  return rc;
+}
+
+// Value text following 'key': in the header dict, or NULL.
+static const char *npy_field(const char *h, size_t len, const char *key) {
+  size_t kl = strlen(key);
+  for (size_t i = 0; i + kl + 2 < len; i++) {
+    if ((h[i] == '\'' || h[i] == '"') && memcmp(h + i + 1, key, kl) == 0 && h[i + 1 + kl] == h[i]) {
+      const char *p = h + i + kl + 2;
+      while (p < h + len && (*p == ' ' || *p == ':')) p++;
+      return p;
+    }
+  }
+  return NULL;
+}
+
+// Parse the header dict; on success *n is the element count.
+static int npy_parse_header(const char *h, size_t len, size_t *n) {
+  const char *d = npy_field(h, len, "descr");
+  if (!d || (size_t)(h + len - d) < 5) return -3;
+  if ((memcmp(d + 1, "<u8", 3) != 0 && memcmp(d + 1, "<i8", 3) != 0) || d[0] != d[4]) return -3;
+
+  const char *f = npy_field(h, len, "fortran_order");
+  if (!f || (size_t)(h + len - f) < 5 || memcmp(f, "False", 5) != 0) return -3;
+
+  const char *s = npy_field(h, len, "shape");
+  if (!s || *s != '(') return -3;
+  s++;
+  while (s < h + len && *s == ' ') s++;
+  size_t v = 0;
+  int digits = 0;
+  while (s < h + len && *s >= '0' && *s <= '9') {
+    if (v > (SIZE_MAX - 9) / 10) return -3;
+    v = v * 10 + (size_t)(*s++ - '0');
+    digits++;
+  }
+  while (s < h + len && (*s == ' ' || *s == 'L')) s++;
+  if (s < h + len && *s == ',') s++;
+  while (s < h + len && *s == ' ') s++;
+  if (!digits || s >= h + len || *s != ')') return -3;   // 1-D only
+  *n = v;
+  return 0;
+}
+
+int bucketsearch_u64_map_npy(const char *path, unsigned threads, bucketsearch_u64_mapped *m) {
+  if (!path || !m) return -1;
+  memset(m, 0, sizeof(*m));
+  if (!host_is_little_endian()) return -5;
+
+  int rc = map_file(path, m);
+  if (rc != 0) return rc;
+
+  const unsigned char *b = (const unsigned char*)m->map;
+  size_t len = m->map_len;
+  size_t hstart, hlen, n = 0;
+  rc = -3;
+  if (len >= 10 && memcmp(b, "\x93NUMPY", 6) == 0) {
+    if (b[6] == 1) {
+      hstart = 10;
+      hlen = (size_t)b[8] | ((size_t)b[9] << 8);
+    } else if ((b[6] == 2 || b[6] == 3) && len >= 12) {
+      hstart = 12;
+      hlen = (size_t)b[8] | ((size_t)b[9] << 8) | ((size_t)b[10] << 16) | ((size_t)b[11] << 24);
+    } else {
+      hstart = len;
+      hlen = 0;
+    }
+    if (hstart + hlen <= len && npy_parse_header((const char*)b + hstart, hlen, &n) == 0 &&
+        n <= (len - hstart - hlen) / sizeof(uint64_t)) {
+      rc = attach_keys(m, hstart + hlen, n, threads);
+    }
+  }
+  if (rc != 0) bucketsearch_u64_unmap(m);
+  return rc;
+}
+
+int bucketsearch_u64_map_keys(const char *path, unsigned threads, bucketsearch_u64_mapped *m) {
+  if (!path || !m) return -1;
+  unsigned char magic[6] = { 0 };
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return -2;
+  ssize_t got = read(fd, magic, sizeof(magic));
+  close(fd);
+  if (got == (ssize_t)sizeof(magic) && memcmp(magic, "\x93NUMPY", 6) == 0)
+    return bucketsearch_u64_map_npy(path, threads, m);
+  return bucketsearch_u64_map_raw(path, threads, m);
+}
+
+void bucketsearch_u64_unmap(bucketsearch_u64_mapped *m) {
+  if (!m) return;
+  if (m->map) munmap(m->map, m->map_len);
+  memset(m, 0, sizeof(*m));
+}
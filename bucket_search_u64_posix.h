@@ -0,0 +1,44 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// POSIX helpers: memory-mapped key loaders and threaded passes over the keys.
+// Link with -pthread.
+
+// A read-only mapping of sorted uint64_t keys.
+typedef struct {
+  const uint64_t *keys;
+  size_t n;
+  void  *map;       // mapping base (file offset 0)
+  size_t map_len;
+} bucketsearch_u64_mapped;
+
+// Map a raw file of little-endian uint64_t keys.
+// threads == 0 uses one thread per online CPU for the sortedness check.
+// Returns 0 on success, nonzero on error:
+//   -1 bad arguments, -2 open/stat/mmap failed (errno is set),
+//   -3 malformed file, -4 keys not sorted, -5 big-endian host.
+int bucketsearch_u64_map_raw(const char *path, unsigned threads, bucketsearch_u64_mapped *m);
+
+// Map a NumPy .npy file (format 1.0-3.0) holding a 1-D '<u8' or '<i8' array.
+// int64 keys must also be sorted as uint64_t (all >= 0, or all < 0).
+// Same return codes as bucketsearch_u64_map_raw.
+int bucketsearch_u64_map_npy(const char *path, unsigned threads, bucketsearch_u64_mapped *m);
+
+// .npy if the file starts with the NumPy magic, raw otherwise.
+int bucketsearch_u64_map_keys(const char *path, unsigned threads, bucketsearch_u64_mapped *m);
+
+void bucketsearch_u64_unmap(bucketsearch_u64_mapped *m);
+
+// Returns 1 if a[0..n) is non-decreasing, 0 if not. Chunks are checked in
+// parallel; threads == 0 uses one thread per online CPU.
+int bucketsearch_u64_is_sorted(const uint64_t *a, size_t n, unsigned threads);
+
+// Parallel bucketsearch_u64_build. BUCKETSEARCH_BUILD_SCAN splits the keys
+// into one slice per thread; BUCKETSEARCH_BUILD_BOUNDS splits the buckets
+// and binary-searches their boundaries (see bucketsearch_u64_build_bounds).
+// threads == 0 uses one thread per online CPU; small inputs use fewer.
+// Returns 0 on success, nonzero on error.
+enum { BUCKETSEARCH_BUILD_SCAN, BUCKETSEARCH_BUILD_BOUNDS };
+int bucketsearch_u64_build_parallel(const uint64_t *a, size_t n, uint32_t K, size_t *start,
+                                    int method, unsigned threads);
@@ -0,0 +1,308 @@
+// bucketsearch: bulk key resolution from the command line.
+// Build:
+//   gcc -O3 -march=native -DNDEBUG -pthread bucketsearch_cli.c bucket_search_u64.c bucket_search_u64_posix.c -o bucketsearch
+// Run:
+//   ./bucketsearch ids.npy < queries.txt > indexes.txt
+//   ./bucketsearch -b -i queries.bin -o indexes.bin ids.bin
+//
+// The key file (raw little-endian uint64 or .npy) is memory-mapped and
+// indexed at startup. Queries are resolved block by block: a reader thread
+// parses block k+1 while the lookup runs on block k and a writer thread
+// formats block k-1.
+//
+// Text mode: whitespace-separated decimal keys in, one index per line out.
+// Binary mode: uint64 keys in, int64 indexes out (little-endian, -1 = miss).
+//
+// On bad input or an I/O error the results of every block read so far are
+// still written, the count is reported on stderr and the exit status is 1.
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bucket_search_u64.h"
+#include "bucket_search_u64_posix.h"
+
+#define NSLOTS 3
+
+typedef struct {
+  uint64_t  *keys;
+  ptrdiff_t *res;
+  size_t     count;
+  int        state;   // SLOT_FREE -> SLOT_READ -> SLOT_DONE -> SLOT_FREE
+  int        last;    // end of input: no more slots follow
+} slot_t;
+
+enum { SLOT_FREE, SLOT_READ, SLOT_DONE };
+
+typedef struct {
+  slot_t slots[NSLOTS];
+  size_t block;
+  int binary;
+  FILE *in, *out;
+  int error;          // set by reader/writer on I/O or parse failure; under mu
+  size_t written;     // results written out; writer only until joined
+  pthread_mutex_t mu;
+  pthread_cond_t cv;
+} pipeline_t;
+
+static slot_t *wait_slot(pipeline_t *pl, size_t k, int state) {
+  slot_t *s = &pl->slots[k % NSLOTS];
+  pthread_mutex_lock(&pl->mu);
+  while (s->state != state) pthread_cond_wait(&pl->cv, &pl->mu);
+  pthread_mutex_unlock(&pl->mu);
+  return s;
+}
+
+static int get_error(pipeline_t *pl) {
+  pthread_mutex_lock(&pl->mu);
+  int e = pl->error;
+  pthread_mutex_unlock(&pl->mu);
+  return e;
+}
+
+// First error wins.
+static void set_error(pipeline_t *pl, int e) {
+  pthread_mutex_lock(&pl->mu);
+  if (!pl->error) pl->error = e;
+  pthread_mutex_unlock(&pl->mu);
+}
+
+static void post_slot(pipeline_t *pl, slot_t *s, int state) {
+  pthread_mutex_lock(&pl->mu);
+  s->state = state;
+  pthread_cond_broadcast(&pl->cv);
+  pthread_mutex_unlock(&pl->mu);
+}
+
+// ---------------- reader ----------------
+
+typedef struct {
+  char  *buf;
+  size_t len, pos;
+  int    eof;
+} text_in_t;
+
+// Next decimal key; 1 on success, 0 at end of input, -1 on bad input.
+static int next_text_key(pipeline_t *pl, text_in_t *t, uint64_t *key) {
+  uint64_t v = 0;
+  int digits = 0;
+  for (;;) {
+    if (t->pos == t->len) {
+      if (t->eof) return digits ? 1 : 0;
+      t->len = fread(t->buf, 1, pl->block, pl->in);
+      t->pos = 0;
+      if (t->len == 0) {
+        t->eof = 1;
+        if (ferror(pl->in)) return -1;
+        if (digits) { *key = v; return 1; }
+        return 0;
+      }
+    }
+    char c = t->buf[t->pos];
+    if (c >= '0' && c <= '9') {
+      uint64_t d = (uint64_t)(c - '0');
+      if (v > (UINT64_MAX - d) / 10) return -1;
+      v = v * 10 + d;
+      digits++;
+      t->pos++;
+    } else if (c == ' ' || c == '\n' || c == '\t' || c == '\r') {
+      t->pos++;
+      if (digits) { *key = v; return 1; }
+    } else {
+      return -1;
+    }
+  }
+}
+
+static void *reader_main(void *arg) {
+  pipeline_t *pl = (pipeline_t*)arg;
+  text_in_t t = { NULL, 0, 0, 0 };
+  if (!pl->binary && !(t.buf = (char*)malloc(pl->block))) set_error(pl, ENOMEM);
+
+  for (size_t k = 0;; k++) {
+    slot_t *s = wait_slot(pl, k, SLOT_FREE);
+    size_t c = 0;
+    if (get_error(pl)) {
+      // drain: downstream stops at the last slot
+    } else if (pl->binary) {
+      size_t bytes = fread(s->keys, 1, pl->block * sizeof(uint64_t), pl->in);
+      c = bytes / sizeof(uint64_t);
+      if (bytes < pl->block * sizeof(uint64_t) && ferror(pl->in)) set_error(pl, EIO);
+      else if (bytes % sizeof(uint64_t)) set_error(pl, EINVAL);   // truncated last key
+    } else {
+      int rc = 1;
+      while (c < pl->block && (rc = next_text_key(pl, &t, &s->keys[c])) == 1) c++;
+      if (rc < 0) set_error(pl, EINVAL);
+    }
+    s->count = c;
+    s->last = (c < pl->block) || get_error(pl);
+    post_slot(pl, s, SLOT_READ);
+    if (s->last) break;
+  }
+  free(t.buf);
+  return NULL;
+}
+
+// ---------------- writer ----------------
+
+static size_t format_index(char *p, ptrdiff_t v) {
+  if (v < 0) { p[0] = '-'; p[1] = '1'; p[2] = '\n'; return 3; }
+  char tmp[24];
+  size_t n = 0;
+  do { tmp[n++] = (char)('0' + v % 10); v /= 10; } while (v);
+  for (size_t i = 0; i < n; i++) p[i] = tmp[n - 1 - i];
+  p[n] = '\n';
+  return n + 1;
+}
+
+static void *writer_main(void *arg) {
+  pipeline_t *pl = (pipeline_t*)arg;
+  char *text = pl->binary ? NULL : (char*)malloc(pl->block * 22);
+  if (!pl->binary && !text) set_error(pl, ENOMEM);
+
+  // every block that was looked up is written, even after an input error;
+  // only a failed write stops the output
+  int failed = !pl->binary && !text;
+  for (size_t k = 0;; k++) {
+    slot_t *s = wait_slot(pl, k, SLOT_DONE);
+    int last = s->last;
+    if (!failed && s->count) {
+      size_t ok;
+      if (pl->binary) {
+        // ptrdiff_t is int64 on the supported targets
+        ok = fwrite(s->res, sizeof(ptrdiff_t), s->count, pl->out) == s->count;
+      } else {
+        size_t len = 0;
+        for (size_t i = 0; i < s->count; i++) len += format_index(text + len, s->res[i]);
+        ok = fwrite(text, 1, len, pl->out) == len;
+      }
+      if (ok) {
+        pl->written += s->count;
+      } else {
+        failed = 1;
+        set_error(pl, EIO);
+      }
+    }
+    post_slot(pl, s, SLOT_FREE);
+    if (last) break;
+  }
+  free(text);
+  return NULL;
+}
+
+// ---------------- main ----------------
+
+static void usage(void) {
+  fprintf(stderr,
+          "usage: bucketsearch [-b] [-K bits] [-B block] [-i queries] [-o results] KEYFILE\n"
+          "  KEYFILE   sorted keys: raw little-endian uint64 or .npy (memory-mapped)\n"
+          "  -b        binary I/O: uint64 keys in, int64 indexes out (-1 = miss)\n"
+          "  -K bits   directory bits, 1..24 (default: about log2(n) - 2)\n"
+          "  -B block  queries per block (default 1048576)\n"
+          "  -i FILE   read queries from FILE instead of stdin\n"
+          "  -o FILE   write results to FILE instead of stdout\n");
+}
+
+int main(int argc, char **argv) {
+  const char *key_path = NULL, *in_path = NULL, *out_path = NULL;
+  uint32_t K = 0;
+  size_t block = (size_t)1 << 20;
+  int binary = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-b") == 0) binary = 1;
+    else if (strcmp(argv[i], "-K") == 0 && i + 1 < argc) K = (uint32_t)strtoul(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "-B") == 0 && i + 1 < argc) block = (size_t)strtoull(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) in_path = argv[++i];
+    else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) out_path = argv[++i];
+    else if (argv[i][0] == '-' && argv[i][1]) { usage(); return 2; }
+    else if (!key_path) key_path = argv[i];
+    else { usage(); return 2; }
+  }
+  if (!key_path || block == 0 || K > 24) { usage(); return 2; }
+
+  bucketsearch_u64_mapped m;
+  int rc = bucketsearch_u64_map_keys(key_path, 0, &m);
+  if (rc != 0) {
+    fprintf(stderr, "bucketsearch: cannot load %s (rc=%d%s%s)\n", key_path, rc,
+            rc == -2 ? ", " : "", rc == -2 ? strerror(errno) : "");
+    return 1;
+  }
+
+  if (K == 0) {
+    // ~4 keys per bucket
+    K = 1;
+    while (K < 24 && ((size_t)1 << (K + 2)) < m.n) K++;
+  }
+  size_t *start = (size_t*)malloc((((size_t)1 << K) + 1) * sizeof(size_t));
+  if (!start || bucketsearch_u64_build(m.keys, m.n, K, start) != 0) {
+    fprintf(stderr, "bucketsearch: index build failed\n");
+    return 1;
+  }
+
+  pipeline_t pl;
+  memset(&pl, 0, sizeof(pl));
+  pl.block = block;
+  pl.binary = binary;
+  pl.in = in_path ? fopen(in_path, binary ? "rb" : "r") : stdin;
+  pl.out = out_path ? fopen(out_path, binary ? "wb" : "w") : stdout;
+  if (!pl.in || !pl.out) {
+    fprintf(stderr, "bucketsearch: cannot open %s\n", !pl.in ? in_path : out_path);
+    return 1;
+  }
+  for (int i = 0; i < NSLOTS; i++) {
+    pl.slots[i].keys = (uint64_t*)malloc(block * sizeof(uint64_t));
+    pl.slots[i].res = (ptrdiff_t*)malloc(block * sizeof(ptrdiff_t));
+    if (!pl.slots[i].keys || !pl.slots[i].res) {
+      fprintf(stderr, "bucketsearch: alloc failed\n");
+      return 1;
+    }
+  }
+  pthread_mutex_init(&pl.mu, NULL);
+  pthread_cond_init(&pl.cv, NULL);
+
+  pthread_t reader, writer;
+  if (pthread_create(&reader, NULL, reader_main, &pl) != 0 ||
+      pthread_create(&writer, NULL, writer_main, &pl) != 0) {
+    fprintf(stderr, "bucketsearch: cannot start threads\n");
+    return 1;
+  }
+
+  size_t total = 0;
+  for (size_t k = 0;; k++) {
+    slot_t *s = wait_slot(&pl, k, SLOT_READ);
+    int last = s->last;
+    bucketsearch_u64_find_batch(m.keys, m.n, K, start, s->keys, s->count, s->res);
+    total += s->count;
+    post_slot(&pl, s, SLOT_DONE);
+    if (last) break;
+  }
+
+  pthread_join(reader, NULL);
+  pthread_join(writer, NULL);
+  // buffered output fails here at the latest (disk full, EPIPE), on stdout too
+  int out_ok = fflush(pl.out) == 0 && !ferror(pl.out);
+  if (out_path && fclose(pl.out) != 0) out_ok = 0;
+  if (!out_ok && !pl.error) pl.error = EIO;
+
+  if (pl.error) {
+    fprintf(stderr, "bucketsearch: %s after %zu queries, %zu results written%s\n",
+            pl.error == EINVAL ? "bad input" : strerror(pl.error), total, pl.written,
+            out_ok ? "" : " (output may be incomplete)");
+  }
+
+  if (in_path) fclose(pl.in);
+  for (int i = 0; i < NSLOTS; i++) {
+    free(pl.slots[i].keys);
+    free(pl.slots[i].res);
+  }
+  pthread_mutex_destroy(&pl.mu);
+  pthread_cond_destroy(&pl.cv);
+  free(start);
+  bucketsearch_u64_unmap(&m);
+  return pl.error ? 1 : 0;
+}
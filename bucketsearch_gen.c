@@ -0,0 +1,207 @@
+// bucketsearch_gen: emit a static BucketSearch table as C/C++ source.
+// Build:
+//   gcc -O2 -pthread bucketsearch_gen.c bucket_search_u64.c bucket_search_u64_posix.c -o bucketsearch_gen
+// Run:
+//   ./bucketsearch_gen -t -n country_ids country_ids.txt > country_ids.h
+//
+// The generated header holds the keys, the precomputed start[] table and
+// the constants (N, K, W, shift) as `static const` data (`static constexpr`
+// in C++), plus `<name>_find(x)` specialized for those constants. Tables
+// land in .rodata: no build cost at startup, and the pages are shared
+// read-only across processes.
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bucket_search_u64.h"
+#include "bucket_search_u64_posix.h"
+
+static void usage(void) {
+  fprintf(stderr,
+          "usage: bucketsearch_gen [-t] [-n name] [-K bits] [-o out.h] KEYFILE\n"
+          "  KEYFILE   sorted keys: raw little-endian uint64 or .npy,\n"
+          "            or with -t one decimal key per line (- for stdin)\n"
+          "  -n name   C identifier prefix (default bs_table)\n"
+          "  -K bits   directory bits, 1..24 (default: about log2(n) - 1)\n"
+          "  -o FILE   write to FILE instead of stdout\n");
+}
+
+static int valid_ident(const char *s) {
+  if (!s[0] || (s[0] >= '0' && s[0] <= '9')) return 0;
+  for (; *s; s++) {
+    char c = *s;
+    if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_')) return 0;
+  }
+  return 1;
+}
+
+// Read whitespace-separated decimal keys; returns NULL on error. Each token
+// must be all digits and fit in 64 bits: "-1" or an overflow would otherwise
+// land in the table as a wrapped or saturated key.
+static uint64_t *read_text_keys(FILE *f, size_t *n) {
+  size_t cap = 1024, cnt = 0;
+  uint64_t *k = (uint64_t*)malloc(cap * sizeof(uint64_t));
+  char tok[32];
+  while (k && fscanf(f, "%31s", tok) == 1) {
+    // a token cut at 31 chars must not resume as the next key
+    int c = fgetc(f);
+    int cut = c != EOF && !isspace(c);
+    if (c != EOF) ungetc(c, f);
+    char *end;
+    errno = 0;
+    unsigned long long v = strtoull(tok, &end, 10);
+    if (cut || tok[0] < '0' || tok[0] > '9' || *end || errno == ERANGE) {
+      fprintf(stderr, "bucketsearch_gen: bad key \"%s\" after %zu keys\n", tok, cnt);
+      free(k);
+      return NULL;
+    }
+    if (cnt == cap) {
+      uint64_t *g = (uint64_t*)realloc(k, (cap *= 2) * sizeof(uint64_t));
+      if (!g) { free(k); return NULL; }
+      k = g;
+    }
+    k[cnt++] = (uint64_t)v;
+  }
+  if (!k || !feof(f)) { free(k); return NULL; }
+  *n = cnt;
+  return k;
+}
+
+static uint32_t bit_width_u64(uint64_t x) {
+  uint32_t w = 0;
+  do { w++; x >>= 1; } while (x);
+  return w;
+}
+
+int main(int argc, char **argv) {
+  const char *path = NULL, *name = "bs_table", *out_path = NULL;
+  uint32_t K = 0;
+  int text = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-t") == 0) text = 1;
+    else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) name = argv[++i];
+    else if (strcmp(argv[i], "-K") == 0 && i + 1 < argc) K = (uint32_t)strtoul(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) out_path = argv[++i];
+    else if (argv[i][0] == '-' && argv[i][1]) { usage(); return 2; }
+    else if (!path) path = argv[i];
+    else { usage(); return 2; }
+  }
+  if (!path || K > 24 || !valid_ident(name)) { usage(); return 2; }
+
+  bucketsearch_u64_mapped m;
+  memset(&m, 0, sizeof(m));
+  uint64_t *owned = NULL;
+  const uint64_t *a;
+  size_t n = 0;
+  if (text) {
+    FILE *f = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!f || !(owned = read_text_keys(f, &n))) {
+      fprintf(stderr, "bucketsearch_gen: cannot read keys from %s\n", path);
+      return 1;
+    }
+    if (f != stdin) fclose(f);
+    if (!bucketsearch_u64_is_sorted(owned, n, 1)) {
+      fprintf(stderr, "bucketsearch_gen: keys are not sorted\n");
+      return 1;
+    }
+    a = owned;
+  } else {
+    int rc = bucketsearch_u64_map_keys(path, 0, &m);
+    if (rc != 0) {
+      fprintf(stderr, "bucketsearch_gen: cannot load %s (rc=%d)\n", path, rc);
+      return 1;
+    }
+    a = m.keys;
+    n = m.n;
+  }
+  if (n == 0) {
+    fprintf(stderr, "bucketsearch_gen: no keys\n");
+    return 1;
+  }
+
+  if (K == 0) {
+    // ~2 keys per bucket: tables are small, spend the bytes on speed
+    K = 1;
+    while (K < 24 && ((size_t)1 << (K + 1)) < n) K++;
+  }
+  const size_t B = (size_t)1 << K;
+  size_t *start = (size_t*)malloc((B + 1) * sizeof(size_t));
+  if (!start || bucketsearch_u64_build(a, n, K, start) != 0) {
+    fprintf(stderr, "bucketsearch_gen: build failed\n");
+    return 1;
+  }
+  const uint32_t W = bit_width_u64(a[n - 1]);
+  size_t max_bucket = 0;
+  for (size_t p = 0; p < B; p++) {
+    if (start[p + 1] - start[p] > max_bucket) max_bucket = start[p + 1] - start[p];
+  }
+  // narrowest offset type that holds n
+  const char *off_t_name = n <= UINT16_MAX ? "uint16_t" : n <= UINT32_MAX ? "uint32_t" : "uint64_t";
+
+  FILE *out = out_path ? fopen(out_path, "w") : stdout;
+  if (!out) {
+    fprintf(stderr, "bucketsearch_gen: cannot open %s\n", out_path);
+    return 1;
+  }
+
+  fprintf(out, "// Generated by bucketsearch_gen from %s. Do not edit.\n", path);
+  fprintf(out, "// n=%zu  K=%u  W=%u  largest bucket=%zu\n", n, K, W, max_bucket);
+  fprintf(out, "#pragma once\n#include <stdint.h>\n#include <stddef.h>\n\n");
+  fprintf(out, "#if defined(__cplusplus)\n  #define %s_DATA static constexpr\n#else\n"
+               "  #define %s_DATA static const\n#endif\n\n", name, name);
+  fprintf(out, "#define %s_N %zu\n", name, n);
+  fprintf(out, "#define %s_K %u\n", name, K);
+  fprintf(out, "#define %s_W %u\n", name, W);
+  if (W >= K) fprintf(out, "#define %s_SHIFT %u  // prefix = x >> SHIFT\n\n", name, W - K);
+  else fprintf(out, "#define %s_SHIFT %u  // prefix = x << SHIFT (W < K)\n\n", name, K - W);
+
+  fprintf(out, "%s_DATA uint64_t %s_keys[%s_N] = {", name, name, name);
+  for (size_t i = 0; i < n; i++) {
+    fprintf(out, "%s%lluu%s", i % 4 ? " " : "\n  ", (unsigned long long)a[i], i + 1 < n ? "," : "");
+  }
+  fprintf(out, "\n};\n\n");
+
+  fprintf(out, "%s_DATA %s %s_start[(1u << %s_K) + 1] = {", name, off_t_name, name, name);
+  for (size_t p = 0; p <= B; p++) {
+    fprintf(out, "%s%zu%s", p % 12 ? " " : "\n  ", start[p], p < B ? "," : "");
+  }
+  fprintf(out, "\n};\n\n");
+
+  // find specialized for the constants above
+  fprintf(out, "// Returns index i if found, or -1 if not found.\n");
+  fprintf(out, "static inline ptrdiff_t %s_find(uint64_t x) {\n", name);
+  fprintf(out, "  if (x > %s_keys[%s_N - 1]) return -1;\n", name, name);
+  if (W >= K) fprintf(out, "  uint32_t p = (uint32_t)(x >> %s_SHIFT);\n", name);
+  else fprintf(out, "  uint32_t p = (uint32_t)(x << %s_SHIFT);\n", name);
+  fprintf(out, "  size_t lo = %s_start[p];\n", name);
+  fprintf(out, "  size_t hi = %s_start[p + 1];\n", name);
+  if (max_bucket <= BUCKETSEARCH_SCAN_MAX) {
+    fprintf(out, "  // every bucket holds at most %zu keys: scan\n", max_bucket);
+    fprintf(out, "  for (; lo < hi; lo++) {\n");
+    fprintf(out, "    if (%s_keys[lo] >= x) return (%s_keys[lo] == x) ? (ptrdiff_t)lo : -1;\n", name, name);
+    fprintf(out, "  }\n  return -1;\n}\n");
+  } else {
+    fprintf(out, "  size_t end = hi;\n");
+    fprintf(out, "  while (lo < hi) {\n");
+    fprintf(out, "    size_t mid = lo + ((hi - lo) >> 1);\n");
+    fprintf(out, "    if (%s_keys[mid] < x) lo = mid + 1;\n", name);
+    fprintf(out, "    else hi = mid;\n  }\n");
+    fprintf(out, "  return (lo != end && %s_keys[lo] == x) ? (ptrdiff_t)lo : -1;\n}\n", name);
+  }
+
+  int err = ferror(out);
+  if (out_path && fclose(out) != 0) err = 1;
+  free(start);
+  free(owned);
+  bucketsearch_u64_unmap(&m);
+  if (err) {
+    fprintf(stderr, "bucketsearch_gen: write failed\n");
+    return 1;
+  }
+  return 0;
+}
@@ -1,3 +1,8 @@
-gcc -O3 -march=native -DNDEBUG test.c -o bucket_search
+gcc -O3 -march=native -DNDEBUG -pthread test.c bucket_search_u64.c bucket_search_u64_arrow.c bucket_search_u64_posix.c -lm -o bucket_search
+gcc -O3 -march=native -DNDEBUG -pthread bucketsearch_cli.c bucket_search_u64.c bucket_search_u64_posix.c -o bucketsearch
+gcc -O2 -pthread bucketsearch_gen.c bucket_search_u64.c bucket_search_u64_posix.c -o bucketsearch_gen
+g++ -std=c++17 -fsyntax-only test_bucket_index.cpp
+g++ -std=c++17 -O2 test_flat_map.cpp -o test_flat_map
+./test_flat_map && rm test_flat_map
 ./bucket_search 5000000 1000000 24 90 123
 rm bucket_search
@@ -1,28 +1,76 @@
-// Benchmark: binary search vs libc bsearch vs interpolation search vs BucketSearch
+// Benchmark: BucketSearch and its variants vs binary search, libc bsearch,
+// interpolation search, branchless binary search, Eytzinger, a static
+// B+-tree, a hash set and a RadixSpline-style learned index
 // Queries: mix of hits/misses (configurable).
 // Build (Linux/glibc):
-//   gcc -O3 -march=native -DNDEBUG bench_search.c -o bench_search
+//   gcc -O3 -march=native -DNDEBUG -pthread test.c bucket_search_u64.c bucket_search_u64_arrow.c bucket_search_u64_posix.c -lm -o bench_search
 // Run:
 //   ./bench_search 5000000 2000000 16 50 123
 //     n=5M, q=2M, K=16, hit%=50, seed=123
+// Options (after or between the positional args):
+//   --dist=sparse   random gaps averaging 1000 (default)
+//   --dist=dense    auto-increment ids with ~1% sparse gaps
+//   --dist=skew     clusters split by rare 2^44 jumps: prefix buckets collapse
+//   --keys=PATH     map sorted keys from a raw uint64 or .npy file (n comes from the file)
+//   --qdist=uniform queries spread over the whole array (default)
+//   --qdist=window  queries in a 1% window of the array that slides across it
+//   --cold          evict the caches before every 16 lookups (at most 2048 lookups per row)
+//   --sporadic=B    stream B bytes of unrelated memory between lookups; only the
+//                   lookups are timed, one by one, less the timer's own cost
+//   --build         instead of the usual rows: build time over n = 1K, 10K, ... up to n,
+//                   K = 1, 4, 8, ... 24, for the scan and boundary-search builds,
+//                   single-threaded and on every CPU
+//   --batch-sweep   instead of the usual rows: bucketsearch_u64_find_batch at batch
+//                   sizes 1, 4, 16, ... 1M, on 1 thread and on --threads=T
+//                   (default: every CPU), with throughput and per-batch latency
+//   --scaling       instead of the usual rows: lookups on 1, 2, 4, ... --threads=T
+//                   threads pinned one per core, then filling SMT siblings first
+//                   (default T: every CPU), with aggregate Mq/s, ns/query per
+//                   thread, modelled DRAM GB/s and the saturation point
+//   --repeat=R      run the usual rows R times (max 64), round-robin after one
+//                   untimed round, and print each row's median
+//   --save=FILE     write every run of the usual rows to FILE as a JSON baseline
+//   --compare=FILE  compare the usual rows against a saved baseline of the same
+//                   configuration: Mann-Whitney rank test per row, exit status 3
+//                   if any row is significantly (one-sided p < 0.01) slower and
+//                   its median moved by more than the noise floor
+//   --noise=PCT     noise floor for --compare, in percent (default 5); a row's
+//                   own run-to-run spread raises it
+//   --pareto        instead of the usual rows: index bytes, build time and ns/query
+//                   for a K sweep over each layout, plus the memory/speed Pareto frontier
 //
 // Notes:
 // - libc bsearch uses a comparator (function call overhead), often slower than inlined binary.
 // - BucketSearch uses top-K bits of the *meaningful* width W (based on max value), then lower_bound in bucket.
 
+#define _GNU_SOURCE  // pthread_setaffinity_np, CPU_SET
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdint.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
+
+#include "bucket_search_u64.h"
+#include "bucket_search_u64_arrow.h"
+#include "bucket_search_u64_posix.h"
+
+#if defined(__AVX2__)
+  #include <immintrin.h>
+#endif
 
 #if defined(__GNUC__) || defined(__clang__)
   #define LIKELY(x)   (__builtin_expect(!!(x), 1))
   #define UNLIKELY(x) (__builtin_expect(!!(x), 0))
+  #define PREFETCH(p) __builtin_prefetch((p), 0, 3)
 #else
   #define LIKELY(x) (x)
   #define UNLIKELY(x) (x)
+  #define PREFETCH(p) ((void)(p))
 #endif
 
 
@@ -67,6 +115,29 @@ static void gen_sorted_sparse_u64(uint64_t *a, size_t n, uint64_t maxV, uint64_t
   }
 }
 
+// Auto-increment ids: step 1, except ~1 in 100 steps skips up to 64 ids.
+static void gen_sorted_dense_u64(uint64_t *a, size_t n, uint64_t seed) {
+  rng64_t r = { seed ? seed : 1ull };
+  uint64_t v = 1;
+  for (size_t i = 0; i < n; i++) {
+    uint64_t x = splitmix64(&r);
+    if (i > 0) v += ((x % 100) == 0) ? 2 + ((x >> 32) % 64) : 1;
+    a[i] = v;
+  }
+}
+
+// Dense clusters of ~10000 keys separated by rare 2^44 jumps: the jumps set
+// the width W, so each cluster piles into one or two prefix buckets.
+static void gen_sorted_skew_u64(uint64_t *a, size_t n, uint64_t seed) {
+  rng64_t r = { seed ? seed : 1ull };
+  uint64_t v = 1;
+  for (size_t i = 0; i < n; i++) {
+    uint64_t x = splitmix64(&r);
+    if (i > 0) v += ((x % 10000) == 0) ? (1ull << 44) : 1 + ((x >> 32) % 1000);
+    a[i] = v;
+  }
+}
+
 // Create queries with a hit-rate:
 // - hit: pick an existing element from array
 // - miss: pick a random value in [1..maxV] and "nudge" it away from existing by adding 1 (likely miss)
@@ -87,6 +158,21 @@ static void gen_queries_u64(uint64_t *q, size_t qn,
   }
 }
 
+// Same hit/miss mix, but all queries fall in a window of n/100 keys that
+// slides from the start of the array to the end over the query stream.
+static void gen_queries_window_u64(uint64_t *q, size_t qn,
+                                   const uint64_t *a, size_t n,
+                                   int hit_percent, uint64_t seed) {
+  rng64_t r = { seed ? seed : 2ull };
+  size_t width = n / 100 ? n / 100 : 1;
+  for (size_t i = 0; i < qn; i++) {
+    size_t base = (size_t)((double)i / (double)qn * (double)(n - width));
+    size_t idx = base + (size_t)(splitmix64(&r) % width);
+    int hit = (int)(splitmix64(&r) % 100) < hit_percent;
+    q[i] = hit ? a[idx] : (a[idx] | 1ull) + 1; // odd+1: likely between keys
+  }
+}
+
 
 static inline ptrdiff_t binary_find_u64(const uint64_t *a, size_t n, uint64_t x) {
   size_t lo = 0, hi = n;
@@ -221,21 +307,249 @@ static inline ptrdiff_t bucketsearch_find_u64(const uint64_t *a, size_t n, uint3
 
 typedef ptrdiff_t (*find_fn)(const uint64_t*, size_t, uint64_t);
 
-static uint64_t bench_find(const char *name, find_fn fn, const uint64_t *a, size_t n, const uint64_t *q, size_t qn) {
+// Cache state the lookups see:
+//   hot       back to back, after the warm-up pass (default)
+//   cold      groups of COLD_GROUP lookups, each group after streaming an
+//             eviction buffer larger than the last-level cache (untimed)
+//   sporadic  g_work_bytes of unrelated memory traffic (untimed) before
+//             every lookup; each lookup is timed on its own, less the cost
+//             of an empty timing interval (g_timer_ns)
+enum { CACHE_HOT, CACHE_COLD, CACHE_SPORADIC };
+static int g_cache_mode = CACHE_HOT;
+static const uint8_t *g_evict = NULL;
+static size_t g_evict_bytes = 0;
+static size_t g_work_bytes = 0;
+static size_t g_evict_pos = 0;
+static uint64_t g_timer_ns = 0;
+
+#define COLD_GROUP  16
+#define COLD_ROUNDS 128
+
+// Last-level cache size, or 0 if the system does not say.
+static size_t llc_bytes(void) {
+  long llc = 0;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+  llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+  return llc > 0 ? (size_t)llc : 0;
+}
+
+// Read one byte per cache line of the next `bytes` of g_evict, wrapping.
+static uint64_t stream_evict(size_t bytes) {
+  uint64_t acc = 0;
+  for (size_t i = 0; i < bytes; i += 64) {
+    acc += g_evict[g_evict_pos];
+    g_evict_pos += 64;
+    if (g_evict_pos >= g_evict_bytes) g_evict_pos = 0;
+  }
+  return acc;
+}
+
+// Cheapest of many empty ns_now() intervals: the part of every timed
+// interval that is the clock, not the lookup.
+static uint64_t timer_overhead_ns(void) {
+  uint64_t best = UINT64_MAX;
+  for (int i = 0; i < 10000; i++) {
+    uint64_t t0 = ns_now();
+    uint64_t d = ns_now() - t0;
+    if (d < best) best = d;
+  }
+  return best;
+}
+
+// Number of queries a row actually runs in the current mode.
+static size_t mode_queries(size_t qn) {
+  if (g_cache_mode != CACHE_COLD) return qn;
+  size_t rounds = qn / COLD_GROUP;
+  if (rounds > COLD_ROUNDS) rounds = COLD_ROUNDS;
+  return rounds ? rounds * COLD_GROUP : qn;
+}
+
+// ns per lookup over the first mode_queries(qn) queries;
+// *sink_out gets the sum of (index + 1).
+static double time_find(find_fn fn, const uint64_t *a, size_t n, const uint64_t *q, size_t qn,
+                        uint64_t *sink_out) {
   // Prevent optimizing away by accumulating results.
   volatile uint64_t sink = 0;
+  volatile uint64_t junk = 0;
+  size_t m = mode_queries(qn);
+  uint64_t dt = 0;
 
-  uint64_t t0 = ns_now();
-  for (size_t i = 0; i < qn; i++) {
-    ptrdiff_t idx = fn(a, n, q[i]);
-    sink += (uint64_t)(idx + 1); // -1 becomes 0
+  if (g_cache_mode == CACHE_COLD) {
+    for (size_t g = 0; g < m; g += COLD_GROUP) {
+      junk += stream_evict(g_evict_bytes);
+      size_t e = (m - g < COLD_GROUP) ? m : g + COLD_GROUP;
+      uint64_t t0 = ns_now();
+      for (size_t i = g; i < e; i++) sink += (uint64_t)(fn(a, n, q[i]) + 1);
+      dt += ns_now() - t0;
+    }
+  } else if (g_cache_mode == CACHE_SPORADIC) {
+    uint64_t raw = 0;
+    for (size_t i = 0; i < qn; i++) {
+      junk += stream_evict(g_work_bytes);
+      uint64_t t0 = ns_now();
+      sink += (uint64_t)(fn(a, n, q[i]) + 1);
+      uint64_t d = ns_now() - t0;
+      raw += d;
+      dt += d > g_timer_ns ? d - g_timer_ns : 0;
+    }
+    // no lookup should vanish into the clock; if they do, the row means nothing
+    if (dt < qn) {
+      fprintf(stderr, "warning: %.3f ns/query measured, %.3f with the timer: below timer resolution\n",
+              (double)dt / (double)qn, (double)raw / (double)qn);
+    }
+  } else {
+    uint64_t t0 = ns_now();
+    for (size_t i = 0; i < qn; i++) {
+      ptrdiff_t idx = fn(a, n, q[i]);
+      sink += (uint64_t)(idx + 1); // -1 becomes 0
+    }
+    dt = ns_now() - t0;
   }
-  uint64_t t1 = ns_now();
 
-  uint64_t dt = t1 - t0;
-  double ns_per = (double)dt / (double)qn;
-  printf("%-24s  %9.3f ns/query   (sink=%llu)\n", name, ns_per, (unsigned long long)sink);
-  return dt;
+  *sink_out = sink;
+  return (double)dt / (double)m;
+}
+
+// Per-row samples of the usual rows, for --save / --compare.
+#define REPEAT_MAX  64
+#define RESULTS_MAX 64
+
+typedef struct {
+  char name[32];
+  unsigned runs;
+  double ns[REPEAT_MAX];
+} bench_result;
+
+static unsigned g_repeat = 1;
+static bench_result g_results[RESULTS_MAX];
+static size_t g_nresults = 0;
+
+static int cmp_double(const void *x, const void *y) {
+  double a = *(const double*)x, b = *(const double*)y;
+  return (a > b) - (a < b);
+}
+
+static double median(const double *ns, unsigned runs) {
+  double sorted[REPEAT_MAX];
+  memcpy(sorted, ns, runs * sizeof(double));
+  qsort(sorted, runs, sizeof(double), cmp_double);
+  return runs % 2 ? sorted[runs / 2] : (sorted[runs / 2 - 1] + sorted[runs / 2]) / 2;
+}
+
+// Record the samples of one row; returns their median.
+static double record_result(const char *name, const double *ns, unsigned runs) {
+  if (g_nresults < RESULTS_MAX) {
+    bench_result *r = &g_results[g_nresults++];
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->runs = runs;
+    memcpy(r->ns, ns, runs * sizeof(double));
+  }
+  return median(ns, runs);
+}
+
+static void print_row(const char *name, const double *ns, unsigned runs, uint64_t sink) {
+  double med = record_result(name, ns, runs);
+  printf("%-24s  %9.3f ns/query   (sink=%llu)", name, med, (unsigned long long)sink);
+  if (runs > 1) {
+    double mean = 0, var = 0;
+    for (unsigned r = 0; r < runs; r++) mean += ns[r];
+    mean /= runs;
+    for (unsigned r = 0; r < runs; r++) var += (ns[r] - mean) * (ns[r] - mean);
+    printf("  median of %u, sd %.3f", runs, sqrt(var / (runs - 1)));
+  }
+  printf("\n");
+}
+
+typedef void (*batch_fn)(const uint64_t*, size_t, uint32_t, const size_t*,
+                         const uint64_t*, size_t, ptrdiff_t*);
+
+// Planner picks the strategy per call.
+static void planned_batch(const uint64_t *a, size_t n, uint32_t K, const size_t *start,
+                          const uint64_t *xs, size_t m, ptrdiff_t *out) {
+  bucketsearch_u64_find_planned(a, n, K, start, NULL, xs, m, out);
+}
+
+// Batched lookups through fn (bucketsearch_u64_find_batch or the planner),
+// `block` queries per call (COLD_GROUP per eviction in cold mode); ns per
+// lookup over the first mode_queries(qn) queries, as time_find.
+static double time_batch(batch_fn fn, const uint64_t *a, size_t n, uint32_t K, const size_t *start,
+                         const uint64_t *q, size_t qn, size_t block, uint64_t *sink_out) {
+  volatile uint64_t sink = 0;
+  volatile uint64_t junk = 0;
+  size_t m = mode_queries(qn);
+  if (g_cache_mode == CACHE_COLD) block = COLD_GROUP;
+  ptrdiff_t *out = (ptrdiff_t*)malloc(block * sizeof(ptrdiff_t));
+  if (!out) {
+    fprintf(stderr, "batch alloc failed\n");
+    return 0;
+  }
+
+  uint64_t dt = 0;
+  for (size_t i = 0; i < m; i += block) {
+    size_t c = (m - i < block) ? m - i : block;
+    if (g_cache_mode == CACHE_COLD) junk += stream_evict(g_evict_bytes);
+    uint64_t t0 = ns_now();
+    fn(a, n, K, start, q + i, c, out);
+    uint64_t s = 0;
+    for (size_t j = 0; j < c; j++) s += (uint64_t)(out[j] + 1);
+    sink += s;
+    dt += ns_now() - t0;
+  }
+  free(out);
+  *sink_out = sink;
+  return (double)dt / (double)m;
+}
+
+// One of the usual rows: single lookups through fn, or batches of `block`
+// through bfn. `note` is printed under the row.
+typedef struct {
+  const char *name;
+  find_fn fn;
+  batch_fn bfn;
+  const uint64_t *q;
+  size_t block;
+  double ns[REPEAT_MAX];
+  uint64_t sink;
+  char note[160];
+} bench_row;
+
+// Round r runs every row once, for g_repeat rounds. Back-to-back repeats
+// would all share whatever the machine was doing at the time (frequency,
+// other tenants), so one row's runs could drift together and look like a
+// regression; interleaved, a slow spell lands on one run of every row.
+// With --repeat an untimed round 0 goes first: the first pass over every
+// structure runs slower and would make each row's first run an outlier.
+static void run_rows(bench_row *rows, size_t nrows, const uint64_t *a, size_t n, uint32_t K,
+                     const size_t *start, size_t qn) {
+  for (unsigned r = g_repeat > 1 ? 0 : 1; r <= g_repeat; r++) {
+    for (size_t i = 0; i < nrows; i++) {
+      bench_row *w = &rows[i];
+      if (w->bfn && g_cache_mode == CACHE_SPORADIC) continue;
+      double ns = w->fn ? time_find(w->fn, a, n, w->q, qn, &w->sink)
+                        : time_batch(w->bfn, a, n, K, start, w->q, qn, w->block, &w->sink);
+      if (r) w->ns[r - 1] = ns;
+    }
+  }
+}
+
+static bench_row *find_row(bench_row *rows, size_t nrows, const char *name) {
+  for (size_t i = 0; i < nrows; i++) {
+    if (strcmp(rows[i].name, name) == 0) return &rows[i];
+  }
+  abort();  // a name typo in main
+}
+
+static void print_rows(const bench_row *rows, size_t nrows) {
+  for (size_t i = 0; i < nrows; i++) {
+    const bench_row *w = &rows[i];
+    if (w->bfn && g_cache_mode == CACHE_SPORADIC) {
+      printf("%-24s  (skipped: batches need queries back to back)\n", w->name);
+    } else {
+      print_row(w->name, w->ns, g_repeat, w->sink);
+    }
+    if (w->note[0]) printf("%-24s  %s\n", "", w->note);
+  }
 }
 
 static ptrdiff_t w_binary(const uint64_t *a, size_t n, uint64_t x) { return binary_find_u64(a, n, x); }
@@ -249,28 +563,1559 @@ static ptrdiff_t w_bucket(const uint64_t *a, size_t n, uint64_t x) {
   return bucketsearch_find_u64(a, n, g_K, g_start, x);
 }
 
+static bucketsearch_u64_heatmap g_heatmap;
+static ptrdiff_t w_heatmap(const uint64_t *a, size_t n, uint64_t x) {
+  return bucketsearch_u64_find_heatmap(a, n, g_K, g_start, &g_heatmap, x);
+}
+
+static const uint64_t *g_dense = NULL;
+static ptrdiff_t w_bucket_dense(const uint64_t *a, size_t n, uint64_t x) {
+  return bucketsearch_u64_find_dense(a, n, g_K, g_start, g_dense, x);
+}
+
+static bucketsearch_u64_bitmap g_bitmap;
+static const bucketsearch_u64_model *g_model = NULL;
+static ptrdiff_t w_bucket_model(const uint64_t *a, size_t n, uint64_t x) {
+  return bucketsearch_u64_find_model(a, n, g_K, g_start, g_model, x);
+}
+
+static const size_t *g_tagged = NULL;
+static ptrdiff_t w_bucket_tagged(const uint64_t *a, size_t n, uint64_t x) {
+  return bucketsearch_u64_find_tagged(a, n, g_K, g_tagged, x);
+}
+
+static const uint64_t *g_sample = NULL;
+static uint32_t g_m = 1;
+static ptrdiff_t w_sample(const uint64_t *a, size_t n, uint64_t x) {
+  return bucketsearch_u64_find_sample(a, n, g_m, g_sample, x);
+}
+
+static bucketsearch_u64_adaptive g_adaptive;
+static ptrdiff_t w_adaptive(const uint64_t *a, size_t n, uint64_t x) {
+  (void)a; (void)n;
+  return bucketsearch_u64_adaptive_find(&g_adaptive, x);
+}
+
+// Row-oriented copy of the keys: 8-byte payload, key, 8-byte payload.
+typedef struct {
+  uint64_t pre;
+  uint64_t key;
+  uint64_t post;
+} row24_t;
+
+static const row24_t *g_rows = NULL;
+static const size_t *g_row_start = NULL;
+static ptrdiff_t w_rows(const uint64_t *a, size_t n, uint64_t x) {
+  (void)a;
+  return bucketsearch_u64_find_rows(g_rows, n, sizeof(row24_t), offsetof(row24_t, key),
+                                    g_K, g_row_start, x);
+}
+
+static bucketsearch_u64_lazy g_lazy;
+static ptrdiff_t w_lazy(const uint64_t *a, size_t n, uint64_t x) {
+  (void)a; (void)n;
+  return bucketsearch_u64_lazy_find(&g_lazy, x);
+}
+
+static bucketsearch_u64_cuckoo g_cuckoo;
+static ptrdiff_t w_cuckoo(const uint64_t *a, size_t n, uint64_t x) {
+  (void)a; (void)n;
+  return bucketsearch_u64_cuckoo_find(&g_cuckoo, x);
+}
+
+static ptrdiff_t w_bitmap(const uint64_t *a, size_t n, uint64_t x) {
+  (void)a; (void)n;
+  return bucketsearch_u64_bitmap_find(&g_bitmap, x);
+}
+
+// start[] narrowed to 32-bit offsets (n < 2^32): half the directory bytes.
+static const uint32_t *g_start32 = NULL;
+static ptrdiff_t w_bucket32(const uint64_t *a, size_t n, uint64_t x) {
+  if (UNLIKELY(n == 0)) return -1;
+  uint32_t W = bit_width_u64(a[n - 1]);
+  uint32_t p = prefix_u64(x, W, g_K);
+  if (UNLIKELY(p >= (1u << g_K))) return -1;
+
+  size_t lo = g_start32[p];
+  size_t hi = g_start32[p + 1];
+  if (lo == hi) return -1;
+  if (x < a[lo] || x > a[hi - 1]) return -1;
+
+  size_t i = lower_bound_u64_range(a, lo, hi, x);
+  if (i != hi && a[i] == x) return (ptrdiff_t)i;
+  return -1;
+}
+
+// ------------- competitors ----------------
+// Each answers the same query with the index into a[], so sinks match the
+// BucketSearch rows.
+
+// Branchless lower bound over the whole array; prefetches both candidates
+// for the probe after next.
+static ptrdiff_t w_branchless(const uint64_t *a, size_t n, uint64_t x) {
+  if (UNLIKELY(n == 0)) return -1;
+  const uint64_t *base = a;
+  size_t len = n;
+  while (len > 1) {
+    size_t half = len >> 1;
+    PREFETCH(base + (half >> 1));
+    PREFETCH(base + half + (half >> 1));
+    base = (base[half] < x) ? base + half : base;
+    len -= half;
+  }
+  size_t i = (size_t)(base - a) + (*base < x);
+  return (i < n && a[i] == x) ? (ptrdiff_t)i : -1;
+}
+
+// Eytzinger (BFS) layout: g_eyt[1..n] holds the keys of the implicit binary
+// tree, g_eyt_idx[k] the position of g_eyt[k] in a[].
+static uint64_t *g_eyt = NULL;
+static size_t *g_eyt_idx = NULL;
+
+static size_t eyt_fill(const uint64_t *a, size_t n, size_t i, size_t k) {
+  if (k <= n) {
+    i = eyt_fill(a, n, i, 2 * k);
+    g_eyt[k] = a[i];
+    g_eyt_idx[k] = i++;
+    i = eyt_fill(a, n, i, 2 * k + 1);
+  }
+  return i;
+}
+
+static ptrdiff_t w_eytzinger(const uint64_t *a, size_t n, uint64_t x) {
+  (void)a;
+  size_t k = 1;
+  while (k <= n) {
+    PREFETCH(g_eyt + 8 * k);   // the 8 descendants three levels down share a line
+    k = 2 * k + (g_eyt[k] < x);
+  }
+  // undo the right turns after the last left turn
+#if defined(__GNUC__) || defined(__clang__)
+  k >>= __builtin_ctzll(~(unsigned long long)k) + 1;
+#else
+  while (k & 1) k >>= 1;
+  k >>= 1;
+#endif
+  return (k && g_eyt[k] == x) ? (ptrdiff_t)g_eyt_idx[k] : -1;
+}
+
+// Static B+-tree with 16-key nodes: level 0 is a padded copy of the keys,
+// level l+1 holds the largest key of every node of level l. A node is
+// searched by counting keys < x, four AVX2 compares when available.
+#define BT_FANOUT 16
+#define BT_MAX_LEVELS 16
+static uint64_t *g_bt[BT_MAX_LEVELS];
+static size_t g_bt_len[BT_MAX_LEVELS];
+static uint32_t g_bt_levels = 0;
+
+static inline size_t bt_count_less(const uint64_t *node, uint64_t x) {
+#if defined(__AVX2__)
+  // unsigned compare as signed after flipping the sign bit
+  const __m256i flip = _mm256_set1_epi64x((long long)0x8000000000000000ull);
+  __m256i xv = _mm256_xor_si256(_mm256_set1_epi64x((long long)x), flip);
+  uint32_t mask = 0;
+  for (int j = 0; j < 4; j++) {
+    __m256i k = _mm256_xor_si256(_mm256_load_si256((const __m256i*)(node + 4 * j)), flip);
+    mask |= (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(xv, k))) << (4 * j);
+  }
+  return (size_t)__builtin_popcount(mask);
+#else
+  size_t c = 0;
+  for (int j = 0; j < BT_FANOUT; j++) c += (node[j] < x);
+  return c;
+#endif
+}
+
+static int bt_build(const uint64_t *a, size_t n) {
+  const uint64_t *src = a;
+  size_t len = n;
+  g_bt_levels = 0;
+  do {
+    size_t padded = (len + BT_FANOUT - 1) / BT_FANOUT * BT_FANOUT;
+    if (padded == 0) padded = BT_FANOUT;
+    uint64_t *lv = (uint64_t*)aligned_alloc(64, padded * sizeof(uint64_t));
+    if (!lv || g_bt_levels == BT_MAX_LEVELS) return -1;
+    if (g_bt_levels == 0) {
+      memcpy(lv, src, len * sizeof(uint64_t));
+    } else {
+      for (size_t j = 0; j < len; j++) {
+        size_t end = (j + 1) * BT_FANOUT;
+        lv[j] = src[(end < g_bt_len[g_bt_levels - 1] ? end : g_bt_len[g_bt_levels - 1]) - 1];
+      }
+    }
+    for (size_t j = len; j < padded; j++) lv[j] = UINT64_MAX;
+    g_bt[g_bt_levels] = lv;
+    g_bt_len[g_bt_levels++] = len;
+    src = lv;
+    len = (len + BT_FANOUT - 1) / BT_FANOUT;
+  } while (g_bt_len[g_bt_levels - 1] > BT_FANOUT);
+  return 0;
+}
+
+static ptrdiff_t w_btree(const uint64_t *a, size_t n, uint64_t x) {
+  if (UNLIKELY(n == 0) || x > a[n - 1]) return -1;
+  size_t j = bt_count_less(g_bt[g_bt_levels - 1], x);
+  for (uint32_t l = g_bt_levels - 1; l-- > 0;) {
+    j = j * BT_FANOUT + bt_count_less(g_bt[l] + j * BT_FANOUT, x);
+  }
+  return (g_bt[0][j] == x) ? (ptrdiff_t)j : -1;
+}
+
+// Open-addressing hash set, linear probing at load <= 1/2. Holds the first
+// position of every key.
+typedef struct {
+  uint64_t key;
+  uint64_t idx;   // HASH_EMPTY if the slot is free
+} hash_slot;
+#define HASH_EMPTY UINT64_MAX
+static hash_slot *g_hash = NULL;
+static size_t g_hash_mask = 0;
+
+static inline uint64_t hash_mix(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xFF51AFD7ED558CCDull;
+  x ^= x >> 33;
+  x *= 0xC4CEB9FE1A85EC53ull;
+  return x ^ (x >> 33);
+}
+
+static int hash_build(const uint64_t *a, size_t n) {
+  size_t cap = 16;
+  while (cap < 2 * n) cap <<= 1;
+  g_hash = (hash_slot*)malloc(cap * sizeof(hash_slot));
+  if (!g_hash) return -1;
+  for (size_t i = 0; i < cap; i++) g_hash[i].idx = HASH_EMPTY;
+  g_hash_mask = cap - 1;
+  for (size_t i = 0; i < n; i++) {
+    size_t h = (size_t)hash_mix(a[i]) & g_hash_mask;
+    while (g_hash[h].idx != HASH_EMPTY && g_hash[h].key != a[i]) h = (h + 1) & g_hash_mask;
+    if (g_hash[h].idx == HASH_EMPTY) {
+      g_hash[h].key = a[i];
+      g_hash[h].idx = i;
+    }
+  }
+  return 0;
+}
+
+static ptrdiff_t w_hash(const uint64_t *a, size_t n, uint64_t x) {
+  (void)a; (void)n;
+  size_t h = (size_t)hash_mix(x) & g_hash_mask;
+  for (;;) {
+    const hash_slot *s = &g_hash[h];
+    if (s->idx == HASH_EMPTY) return -1;
+    if (s->key == x) return (ptrdiff_t)s->idx;
+    h = (h + 1) & g_hash_mask;
+  }
+}
+
+// RadixSpline-style learned index: a greedy spline through (key, position)
+// with at most RS_ERR positions of error, and a radix table on the top bits
+// of key - a[0] that narrows the search for the spline segment.
+#define RS_ERR 32
+#define RS_RADIX_BITS 18
+typedef struct {
+  uint64_t x;
+  double   y;
+} rs_point;
+static rs_point *g_rs = NULL;
+static size_t g_rs_n = 0;
+static uint32_t *g_rs_radix = NULL;
+static uint32_t g_rs_bits = 0, g_rs_shift = 0;
+
+// > 0: (dx2, dy2) turns clockwise from (dx1, dy1); < 0: counter-clockwise.
+static inline int rs_orient(double dx1, double dy1, double dx2, double dy2) {
+  double e = dy1 * dx2 - dy2 * dx1;
+  return (e > 1e-12) - (e < -1e-12);
+}
+
+static int rs_build(const uint64_t *a, size_t n) {
+  g_rs = (rs_point*)malloc((n + 1) * sizeof(rs_point));
+  if (!g_rs) return -1;
+  g_rs_n = 0;
+  rs_point up = { 0, 0 }, lo = { 0, 0 };
+  uint64_t px = 0;
+  double py = 0;
+  size_t seen = 0;   // distinct keys so far
+  for (size_t i = 0; i < n; i++) {
+    uint64_t x = a[i];
+    double y = (double)i;
+    if (seen && x == px) continue;   // duplicates keep their first position
+    if (seen == 0) {
+      g_rs[g_rs_n].x = x;
+      g_rs[g_rs_n++].y = y;
+    } else if (seen == 1) {
+      up.x = lo.x = x;
+      up.y = y + RS_ERR;
+      lo.y = y - RS_ERR;
+    } else {
+      // does (x, y) stay inside the corridor from the last spline point?
+      const rs_point *last = &g_rs[g_rs_n - 1];
+      double ux = (double)(up.x - last->x), uy = up.y - last->y;
+      double lx = (double)(lo.x - last->x), ly = lo.y - last->y;
+      double dx = (double)(x - last->x);
+      if (rs_orient(ux, uy, dx, y - last->y) <= 0 || rs_orient(lx, ly, dx, y - last->y) >= 0) {
+        g_rs[g_rs_n].x = px;
+        g_rs[g_rs_n++].y = py;
+        up.x = lo.x = x;
+        up.y = y + RS_ERR;
+        lo.y = y - RS_ERR;
+      } else {
+        if (rs_orient(ux, uy, dx, y + RS_ERR - last->y) > 0) { up.x = x; up.y = y + RS_ERR; }
+        if (rs_orient(lx, ly, dx, y - RS_ERR - last->y) < 0) { lo.x = x; lo.y = y - RS_ERR; }
+      }
+    }
+    px = x;
+    py = y;
+    seen++;
+  }
+  if (seen && g_rs[g_rs_n - 1].x != px) {
+    g_rs[g_rs_n].x = px;
+    g_rs[g_rs_n++].y = py;
+  }
+
+  // radix[b] = number of spline points whose prefix is < b
+  uint32_t W = bit_width_u64(n ? a[n - 1] - a[0] : 0);
+  g_rs_bits = bit_width_u64(n) < RS_RADIX_BITS ? bit_width_u64(n) : RS_RADIX_BITS;
+  g_rs_shift = W > g_rs_bits ? W - g_rs_bits : 0;
+  size_t R = (size_t)1 << g_rs_bits;
+  g_rs_radix = (uint32_t*)calloc(R + 2, sizeof(uint32_t));
+  if (!g_rs_radix) return -1;
+  for (size_t j = 0; j < g_rs_n; j++) g_rs_radix[((g_rs[j].x - a[0]) >> g_rs_shift) + 1]++;
+  for (size_t b = 1; b < R + 2; b++) g_rs_radix[b] += g_rs_radix[b - 1];
+  return 0;
+}
+
+static ptrdiff_t w_radixspline(const uint64_t *a, size_t n, uint64_t x) {
+  if (UNLIKELY(n == 0) || x < a[0] || x > a[n - 1]) return -1;
+  size_t b = (size_t)((x - a[0]) >> g_rs_shift);
+  // the first spline point >= x is in [radix[b], radix[b + 1]]
+  size_t lo = g_rs_radix[b], hi = g_rs_radix[b + 1] + 1;
+  if (hi > g_rs_n) hi = g_rs_n;
+  while (lo < hi) {
+    size_t mid = lo + ((hi - lo) >> 1);
+    if (g_rs[mid].x < x) lo = mid + 1;
+    else hi = mid;
+  }
+  const rs_point *p1 = &g_rs[lo];
+  if (p1->x == x) return (ptrdiff_t)p1->y;
+  const rs_point *p0 = p1 - 1;
+  double pred = p0->y + (double)(x - p0->x) * (p1->y - p0->y) / (double)(p1->x - p0->x);
+
+  size_t p = (size_t)pred;
+  size_t wlo = p > RS_ERR + 1 ? p - RS_ERR - 1 : 0;
+  size_t whi = p + RS_ERR + 2 < n ? p + RS_ERR + 2 : n;
+  // rounding can push the answer just outside the window: fall back to all
+  if ((wlo > 0 && a[wlo - 1] >= x) || (whi < n && a[whi - 1] < x)) { wlo = 0; whi = n; }
+  size_t i = lower_bound_u64_range(a, wlo, whi, x);
+  return (i < n && a[i] == x) ? (ptrdiff_t)i : -1;
+}
+
+// Build time of each competitor: Eytzinger, B+-tree, hash, RadixSpline.
+static uint64_t g_comp_build_ns[4];
+
+// Build every competitor over a[0..n); returns 0 on success.
+static int competitors_build(const uint64_t *a, size_t n) {
+  uint64_t t0 = ns_now();
+  g_eyt = (uint64_t*)aligned_alloc(64, ((n + 1) * sizeof(uint64_t) + 63) / 64 * 64);
+  g_eyt_idx = (size_t*)malloc((n + 1) * sizeof(size_t));
+  if (!g_eyt || !g_eyt_idx) return -1;
+  eyt_fill(a, n, 0, 1);
+  g_comp_build_ns[0] = ns_now() - t0;
+
+  t0 = ns_now();
+  if (bt_build(a, n) != 0) return -1;
+  g_comp_build_ns[1] = ns_now() - t0;
+  t0 = ns_now();
+  if (hash_build(a, n) != 0) return -1;
+  g_comp_build_ns[2] = ns_now() - t0;
+  t0 = ns_now();
+  if (rs_build(a, n) != 0) return -1;
+  g_comp_build_ns[3] = ns_now() - t0;
+  return 0;
+}
+
+static void competitors_free(void) {
+  free(g_eyt);
+  free(g_eyt_idx);
+  for (uint32_t l = 0; l < g_bt_levels; l++) free(g_bt[l]);
+  free(g_hash);
+  free(g_rs);
+  free(g_rs_radix);
+}
+
+// Bytes each competitor needs beyond the sorted keys. The B+-tree counts
+// every level, level 0 too: lookups read its padded, aligned copy of the
+// keys, never a[].
+static double eyt_bytes(size_t n) { return (double)(n + 1) * (sizeof(uint64_t) + sizeof(size_t)); }
+static double bt_bytes(void) {
+  double b = 0;
+  for (uint32_t l = 0; l < g_bt_levels; l++) b += (double)((g_bt_len[l] + BT_FANOUT - 1) / BT_FANOUT * BT_FANOUT) * 8;
+  return b;
+}
+static double hash_bytes(void) { return (double)(g_hash_mask + 1) * sizeof(hash_slot); }
+static double rs_bytes(void) {
+  return (double)g_rs_n * sizeof(rs_point) + (double)(((size_t)1 << g_rs_bits) + 2) * sizeof(uint32_t);
+}
+
+// ------------- build time (--build) ----------------
+
+typedef int (*build_fn)(const uint64_t*, size_t, uint32_t, size_t*);
+
+static int build_scan_par(const uint64_t *a, size_t n, uint32_t K, size_t *start) {
+  return bucketsearch_u64_build_parallel(a, n, K, start, BUCKETSEARCH_BUILD_SCAN, 0);
+}
+static int build_bounds_par(const uint64_t *a, size_t n, uint32_t K, size_t *start) {
+  return bucketsearch_u64_build_parallel(a, n, K, start, BUCKETSEARCH_BUILD_BOUNDS, 0);
+}
+
+// Repeat until 20 ms have passed; returns ns per build.
+static double time_build(build_fn fn, const uint64_t *a, size_t n, uint32_t K, size_t *start) {
+  uint64_t t0 = ns_now(), dt;
+  size_t reps = 0;
+  do {
+    fn(a, n, K, start);
+    reps++;
+    dt = ns_now() - t0;
+  } while (dt < 20000000ull);
+  return (double)dt / (double)reps;
+}
+
+// Every build variant over a grid of n (prefixes of a) and K. GB/s counts
+// the key bytes, so the boundary search can exceed memory bandwidth when it
+// skips most keys.
+static int build_report(const uint64_t *a, size_t nmax) {
+  static const struct { const char *name; build_fn fn; } builds[] = {
+    { "scan",        bucketsearch_u64_build },
+    { "bounds",      bucketsearch_u64_build_bounds },
+    { "scan par",    build_scan_par },
+    { "bounds par",  build_bounds_par },
+  };
+  static const uint32_t Ks[] = { 1, 4, 8, 12, 16, 20, 24 };
+  size_t *ref = (size_t*)malloc((((size_t)1 << 24) + 1) * sizeof(size_t));
+  size_t *start = (size_t*)malloc((((size_t)1 << 24) + 1) * sizeof(size_t));
+  if (!ref || !start) {
+    fprintf(stderr, "build alloc failed\n");
+    return 1;
+  }
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  printf("(par = up to %ld threads, at least 1M keys each)\n\n", cpus > 0 ? cpus : 1);
+  printf("%12s  %3s  %-12s  %10s  %8s  %9s\n", "n", "K", "build", "ms", "GB/s", "ns/key");
+
+  for (size_t n = 1000; ; n = (n * 10 > nmax && n < nmax) ? nmax : n * 10) {
+    if (n > nmax) break;
+    for (size_t k = 0; k < sizeof(Ks) / sizeof(Ks[0]); k++) {
+      uint32_t K = Ks[k];
+      const size_t B = (size_t)1 << K;
+      bucketsearch_build_u64(a, n, K, ref);
+      for (size_t b = 0; b < sizeof(builds) / sizeof(builds[0]); b++) {
+        double ns = time_build(builds[b].fn, a, n, K, start);
+        int same = memcmp(ref, start, (B + 1) * sizeof(size_t)) == 0;
+        printf("%12zu  %3u  %-12s  %10.3f  %8.2f  %9.3f%s\n", n, K, builds[b].name, ns / 1e6,
+               (double)n * sizeof(uint64_t) / ns, ns / (double)n, same ? "" : "  (table mismatch)");
+      }
+    }
+    if (n == nmax) break;
+  }
+  free(ref);
+  free(start);
+  return 0;
+}
+
+// ------------- batch size sweep (--batch-sweep) ----------------
+
+typedef struct {
+  const uint64_t *a;
+  size_t n;
+  uint32_t K;
+  const size_t *start;
+  const uint64_t *q;
+  size_t qn;
+  size_t batch, batches, offset;
+  uint64_t *lat;      // ns per batch
+  ptrdiff_t *out;
+  uint64_t sink;
+} sweep_job;
+
+static void *sweep_worker(void *arg) {
+  sweep_job *j = (sweep_job*)arg;
+  uint64_t sink = 0;
+  size_t pos = j->offset;
+  for (size_t b = 0; b < j->batches; b++) {
+    if (pos + j->batch > j->qn) pos = 0;
+    uint64_t t0 = ns_now();
+    bucketsearch_u64_find_batch(j->a, j->n, j->K, j->start, j->q + pos, j->batch, j->out);
+    j->lat[b] = ns_now() - t0;
+    for (size_t i = 0; i < j->batch; i++) sink += (uint64_t)(j->out[i] + 1);
+    pos += j->batch;
+  }
+  j->sink = sink;
+  return NULL;
+}
+
+static int cmp_u64_asc(const void *x, const void *y) {
+  uint64_t a = *(const uint64_t*)x, b = *(const uint64_t*)y;
+  return (a > b) - (a < b);
+}
+
+// Each size runs max(qn / batch, 16) batches per thread over the query
+// array (wrapping); sizes above qn cycle the queries to fill one batch. Throughput is all queries over wall time; latency
+// percentiles are over every batch of every thread and include one
+// clock read.
+static int batch_sweep_report(const uint64_t *a, size_t n, uint32_t K,
+                              const uint64_t *q, size_t qn, unsigned threads) {
+  const size_t B = (size_t)1 << K;
+  size_t *start = (size_t*)malloc((B + 1) * sizeof(size_t));
+  if (!start || bucketsearch_build_u64(a, n, K, start) != 0) {
+    fprintf(stderr, "sweep build failed\n");
+    return 1;
+  }
+  if (threads == 0) {
+    long c = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = c > 0 ? (unsigned)c : 1u;
+  }
+  if (threads > 256) threads = 256;
+
+  const size_t max_batch = (size_t)1 << 20;
+  uint64_t *wrap = NULL;
+  if (qn < max_batch) {
+    wrap = (uint64_t*)malloc(max_batch * sizeof(uint64_t));
+    if (!wrap) {
+      fprintf(stderr, "sweep alloc failed\n");
+      return 1;
+    }
+    for (size_t i = 0; i < max_batch; i++) wrap[i] = q[i % qn];
+  }
+
+  printf("%9s  %7s  %9s  %9s  %10s  %10s  %10s\n",
+         "batch", "threads", "Mq/s", "ns/query", "p50 us", "p99 us", "max us");
+  unsigned tcounts[2] = { 1, threads };
+  for (size_t batch = 1; batch <= max_batch; batch *= 4) {
+    const uint64_t *bq = batch <= qn ? q : wrap;
+    size_t bqn = batch <= qn ? qn : batch;
+    for (int v = 0; v < (threads > 1 ? 2 : 1); v++) {
+      unsigned T = tcounts[v];
+      size_t batches = bqn / batch > 16 ? bqn / batch : 16;
+      sweep_job jobs[256];
+      pthread_t tid[256];
+      uint64_t *lat = (uint64_t*)malloc((size_t)T * batches * sizeof(uint64_t));
+      ptrdiff_t *out = (ptrdiff_t*)malloc((size_t)T * batch * sizeof(ptrdiff_t));
+      if (!lat || !out) {
+        fprintf(stderr, "sweep alloc failed\n");
+        return 1;
+      }
+      for (unsigned t = 0; t < T; t++) {
+        sweep_job *j = &jobs[t];
+        j->a = a; j->n = n; j->K = K; j->start = start;
+        j->q = bq; j->qn = bqn;
+        j->batch = batch;
+        j->batches = batches;
+        j->offset = (bqn / T) * t / batch * batch;
+        j->lat = lat + (size_t)t * batches;
+        j->out = out + (size_t)t * batch;
+      }
+      uint64_t t0 = ns_now();
+      unsigned started = 1;
+      for (unsigned t = 1; t < T; t++, started++) {
+        if (pthread_create(&tid[t], NULL, sweep_worker, &jobs[t]) != 0) break;
+      }
+      for (unsigned t = started; t < T; t++) sweep_worker(&jobs[t]);
+      sweep_worker(&jobs[0]);
+      for (unsigned t = 1; t < started; t++) pthread_join(tid[t], NULL);
+      uint64_t wall = ns_now() - t0;
+
+      size_t nlat = (size_t)T * batches;
+      qsort(lat, nlat, sizeof(uint64_t), cmp_u64_asc);
+      double total = (double)nlat * (double)batch;
+      printf("%9zu  %7u  %9.2f  %9.3f  %10.3f  %10.3f  %10.3f\n", batch, T,
+             total / (double)wall * 1e3, (double)wall * T / total,
+             (double)lat[nlat / 2] / 1e3, (double)lat[nlat * 99 / 100] / 1e3, (double)lat[nlat - 1] / 1e3);
+      free(lat);
+      free(out);
+    }
+  }
+  free(wrap);
+  free(start);
+  return 0;
+}
+
+// ------------- thread scaling (--scaling) ----------------
+
+#define SCALE_MAX_CPUS 1024
+
+typedef struct {
+  const uint64_t *a;
+  size_t n;
+  uint32_t K;
+  const size_t *start;
+  const uint64_t *q;
+  size_t qn, offset;
+  int cpu;            // -1: not pinned
+  pthread_barrier_t *go;
+  uint64_t t0, t1, sink;
+} scale_job;
+
+static void *scale_worker(void *arg) {
+  scale_job *j = (scale_job*)arg;
+#if defined(__linux__)
+  if (j->cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(j->cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+#endif
+  pthread_barrier_wait(j->go);
+  uint64_t sink = 0;
+  j->t0 = ns_now();
+  for (size_t i = j->offset; i < j->qn; i++) sink += (uint64_t)(bucketsearch_find_u64(j->a, j->n, j->K, j->start, j->q[i]) + 1);
+  for (size_t i = 0; i < j->offset; i++) sink += (uint64_t)(bucketsearch_find_u64(j->a, j->n, j->K, j->start, j->q[i]) + 1);
+  j->t1 = ns_now();
+  j->sink = sink;
+  return NULL;
+}
+
+static long read_topology(int cpu, const char *what) {
+  char path[96];
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, what);
+  FILE *f = fopen(path, "r");
+  long v = -1;
+  if (f) {
+    if (fscanf(f, "%ld", &v) != 1) v = -1;
+    fclose(f);
+  }
+  return v;
+}
+
+// Usable CPUs in two pinning orders: spread puts one thread per physical
+// core before any SMT sibling, packed fills each core's siblings first.
+// Returns the CPU count and the number of physical cores.
+static int cpu_orders(int *spread, int *packed, int *ncores) {
+  int cpus[SCALE_MAX_CPUS];
+  long core[SCALE_MAX_CPUS];
+  int ncpu = 0;
+#if defined(__linux__)
+  cpu_set_t set;
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int c = 0; c < CPU_SETSIZE && ncpu < SCALE_MAX_CPUS; c++) {
+      if (CPU_ISSET(c, &set)) cpus[ncpu++] = c;
+    }
+  }
+#endif
+  if (ncpu == 0) {
+    long c = sysconf(_SC_NPROCESSORS_ONLN);
+    for (; ncpu < (c > 0 ? c : 1) && ncpu < SCALE_MAX_CPUS; ncpu++) cpus[ncpu] = -1;
+    *ncores = ncpu;
+    for (int i = 0; i < ncpu; i++) spread[i] = packed[i] = -1;
+    return ncpu;
+  }
+  // physical core = (package, core_id); unknown topology counts each CPU as a core
+  for (int i = 0; i < ncpu; i++) {
+    long pkg = read_topology(cpus[i], "physical_package_id");
+    long id = read_topology(cpus[i], "core_id");
+    core[i] = (pkg < 0 || id < 0) ? -1 - i : pkg * 65536 + id;
+  }
+  int ns = 0, np = 0, cores = 0;
+  char used[SCALE_MAX_CPUS] = { 0 };
+  for (int i = 0; i < ncpu; i++) {
+    int first = 1;
+    for (int j = 0; j < i && first; j++) first = core[j] != core[i];
+    if (!first) continue;
+    cores++;
+    spread[ns++] = cpus[i];
+    used[i] = 1;
+    for (int j = i; j < ncpu; j++) {
+      if (core[j] == core[i]) packed[np++] = cpus[j];
+    }
+  }
+  for (int i = 0; i < ncpu; i++) {
+    if (!used[i]) spread[ns++] = cpus[i];
+  }
+  *ncores = cores;
+  return ncpu;
+}
+
+// Mean distinct cache lines a lookup touches (start[p], start[p + 1] and
+// every probed key), over a sample of the queries.
+static double lines_per_lookup(const uint64_t *a, size_t n, uint32_t K, const size_t *start,
+                               const uint64_t *q, size_t qn) {
+  if (n == 0 || qn == 0) return 0;
+  const uint32_t W = bit_width_u64(a[n - 1]);
+  size_t step = qn / 4096 + 1, samples = 0, lines = 0;
+  for (size_t i = 0; i < qn; i += step, samples++) {
+    uint64_t x = q[i];
+    if (x > a[n - 1]) { lines++; continue; }   // a[n - 1] only
+    uint32_t p = prefix_u64(x, W, K);
+    uintptr_t s0 = (uintptr_t)&start[p] / 64, s1 = (uintptr_t)&start[p + 1] / 64;
+    lines += 1 + (s0 != s1);
+    size_t lo = start[p], hi = start[p + 1];
+    uintptr_t last = (uintptr_t)-1;
+    if (lo < hi) {
+      uintptr_t l = (uintptr_t)&a[lo] / 64;
+      lines++;
+      last = l;
+    }
+    while (lo < hi) {
+      size_t mid = lo + ((hi - lo) >> 1);
+      uintptr_t l = (uintptr_t)&a[mid] / 64;
+      if (l != last) lines++;
+      last = l;
+      if (a[mid] < x) lo = mid + 1;
+      else hi = mid;
+    }
+  }
+  return (double)lines / (double)samples;
+}
+
+// Every thread runs all qn queries from its own offset. DRAM traffic is a
+// model: lines per lookup x the share of the index (keys + start[]) that
+// cannot stay in the last-level cache, with no hardware counters involved.
+// Saturation is the first thread count within 5% of the best throughput.
+static int scaling_report(const uint64_t *a, size_t n, uint32_t K,
+                          const uint64_t *q, size_t qn, unsigned max_threads) {
+  const size_t B = (size_t)1 << K;
+  size_t *start = (size_t*)malloc((B + 1) * sizeof(size_t));
+  if (!start || bucketsearch_build_u64(a, n, K, start) != 0) {
+    fprintf(stderr, "scaling build failed\n");
+    return 1;
+  }
+  static int spread[SCALE_MAX_CPUS], packed[SCALE_MAX_CPUS];
+  int ncores = 0;
+  int ncpu = cpu_orders(spread, packed, &ncores);
+  unsigned T = max_threads ? max_threads : (unsigned)ncpu;
+  if (T > SCALE_MAX_CPUS) T = SCALE_MAX_CPUS;
+
+  size_t llc = llc_bytes();
+  double footprint = (double)n * sizeof(uint64_t) + (double)(B + 1) * sizeof(size_t);
+  double miss = (llc && footprint > (double)llc) ? 1.0 - (double)llc / footprint : (llc ? 0.0 : 1.0);
+  double lines = lines_per_lookup(a, n, K, start, q, qn);
+  printf("(%d CPUs, %d physical cores, LLC %.1f MiB%s; index %.1f MiB, %.2f lines/lookup, %.0f%% modelled off-chip)\n",
+         ncpu, ncores, (double)llc / (1 << 20), llc ? "" : " unknown", footprint / (1 << 20), lines, miss * 100);
+  if ((int)T > ncpu) printf("(more threads than CPUs: threads past %d are not pinned)\n", ncpu);
+
+  scale_job *jobs = (scale_job*)calloc(T, sizeof(scale_job));
+  pthread_t *tid = (pthread_t*)malloc(T * sizeof(pthread_t));
+  double *mqs = (double*)malloc(T * sizeof(double));
+  unsigned *counts = (unsigned*)malloc((T + 32) * sizeof(unsigned));
+  if (!jobs || !tid || !mqs || !counts) {
+    fprintf(stderr, "scaling alloc failed\n");
+    return 1;
+  }
+  size_t nc = 0;
+  for (unsigned t = 1; t < T; t *= 2) counts[nc++] = t;
+  counts[nc++] = T;
+
+  int has_smt = ncpu > ncores;
+  for (int order = 0; order < (has_smt ? 2 : 1); order++) {
+    const int *cpus = order ? packed : spread;
+    printf("\n%s\n", !has_smt ? "pinned one thread per CPU (no SMT siblings)"
+                    : order ? "pinned SMT siblings first" : "pinned one thread per core, then SMT siblings");
+    printf("%7s  %9s  %9s  %11s  %9s\n", "threads", "Mq/s", "speedup", "ns/q/thread", "DRAM GB/s");
+    double best = 0;
+    for (size_t c = 0; c < nc; c++) {
+      unsigned k = counts[c];
+      pthread_barrier_t go;
+      pthread_barrier_init(&go, NULL, k);
+      unsigned started = 0;
+      for (unsigned t = 0; t < k; t++) {
+        scale_job *j = &jobs[t];
+        j->a = a; j->n = n; j->K = K; j->start = start;
+        j->q = q; j->qn = qn;
+        j->offset = (size_t)((double)qn * t / k);
+        j->cpu = (int)t < ncpu ? cpus[t] : -1;
+        j->go = &go;
+        if (pthread_create(&tid[t], NULL, scale_worker, j) != 0) break;
+        started++;
+      }
+      if (started < k) {
+        fprintf(stderr, "cannot start %u threads\n", k);
+        return 1;
+      }
+      for (unsigned t = 0; t < k; t++) pthread_join(tid[t], NULL);
+      pthread_barrier_destroy(&go);
+
+      uint64_t t0 = jobs[0].t0, t1 = jobs[0].t1;
+      for (unsigned t = 0; t < k; t++) {
+        if (jobs[t].t0 < t0) t0 = jobs[t].t0;
+        if (jobs[t].t1 > t1) t1 = jobs[t].t1;
+        if (jobs[t].sink != jobs[0].sink) fprintf(stderr, "thread %u sink mismatch\n", t);
+      }
+      double total = (double)qn * k;
+      mqs[c] = total / (double)(t1 - t0) * 1e3;
+      if (mqs[c] > best) best = mqs[c];
+      printf("%7u  %9.2f  %8.2fx  %11.3f  %9.2f\n", k, mqs[c], mqs[c] / mqs[0],
+             (double)(t1 - t0) * k / total, mqs[c] * 1e6 * lines * miss * 64 / 1e9);
+    }
+    for (size_t c = 0; c < nc; c++) {
+      if (mqs[c] >= 0.95 * best) {
+        printf("saturation: %u threads (%.2f Mq/s, %.0f%% of the best)\n", counts[c], mqs[c], mqs[c] / best * 100);
+        break;
+      }
+    }
+  }
+  free(counts);
+  free(mqs);
+  free(tid);
+  free(jobs);
+  free(start);
+  return 0;
+}
+
+// ------------- baselines (--save / --compare) ----------------
+
+static void json_string(FILE *f, const char *s) {
+  fputc('"', f);
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\') fputc('\\', f);
+    fputc(*s, f);
+  }
+  fputc('"', f);
+}
+
+static int save_baseline(const char *path, const char *config) {
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    fprintf(stderr, "cannot write %s\n", path);
+    return 1;
+  }
+  fprintf(f, "{\n  \"config\": ");
+  json_string(f, config);
+  fprintf(f, ",\n  \"results\": [");
+  for (size_t i = 0; i < g_nresults; i++) {
+    const bench_result *r = &g_results[i];
+    fprintf(f, "%s\n    {\"name\": ", i ? "," : "");
+    json_string(f, r->name);
+    fprintf(f, ", \"ns\": [");
+    for (unsigned k = 0; k < r->runs; k++) fprintf(f, "%s%.17g", k ? ", " : "", r->ns[k]);
+    fprintf(f, "]}");
+  }
+  fprintf(f, "\n  ]\n}\n");
+  int err = ferror(f);
+  if (fclose(f) != 0 || err) {
+    fprintf(stderr, "cannot write %s\n", path);
+    return 1;
+  }
+  return 0;
+}
+
+// Parse the JSON string starting at *p (at the opening quote) into out.
+static int json_read_string(const char **p, char *out, size_t cap) {
+  const char *s = *p;
+  if (*s++ != '"') return -1;
+  size_t len = 0;
+  for (; *s && *s != '"'; s++) {
+    if (*s == '\\' && s[1]) s++;
+    if (len + 1 < cap) out[len++] = *s;
+  }
+  if (*s != '"') return -1;
+  out[len] = 0;
+  *p = s + 1;
+  return 0;
+}
+
+// Skip to the value of the next "key": after *p; NULL if none.
+static const char *json_find_key(const char *p, const char *key) {
+  char pat[32];
+  snprintf(pat, sizeof(pat), "\"%s\"", key);
+  p = strstr(p, pat);
+  if (!p) return NULL;
+  p += strlen(pat);
+  while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == ':') p++;
+  return p;
+}
+
+// Reads the files save_baseline writes, not general JSON.
+static int load_baseline(const char *path, char *config, size_t config_cap,
+                         bench_result *rows, size_t *nrows) {
+  FILE *f = fopen(path, "r");
+  if (!f) return -1;
+  size_t cap = 1 << 16, len = 0;
+  char *buf = (char*)malloc(cap);
+  size_t got;
+  while (buf && (got = fread(buf + len, 1, cap - len - 1, f)) > 0) {
+    len += got;
+    if (len + 1 == cap) {
+      char *g = (char*)realloc(buf, cap *= 2);
+      if (!g) { free(buf); buf = NULL; }
+      buf = g;
+    }
+  }
+  fclose(f);
+  if (!buf) return -1;
+  buf[len] = 0;
+
+  int rc = -1;
+  const char *p = json_find_key(buf, "config");
+  if (p && json_read_string(&p, config, config_cap) == 0) {
+    *nrows = 0;
+    while (*nrows < RESULTS_MAX && (p = json_find_key(p, "name")) != NULL) {
+      bench_result *r = &rows[*nrows];
+      if (json_read_string(&p, r->name, sizeof(r->name)) != 0) break;
+      if (!(p = json_find_key(p, "ns")) || *p++ != '[') break;
+      r->runs = 0;
+      for (;;) {
+        while (*p == ' ' || *p == ',' || *p == '\n') p++;
+        if (*p == ']') break;
+        char *e;
+        double v = strtod(p, &e);
+        if (e == p) break;
+        if (r->runs < REPEAT_MAX) r->ns[r->runs++] = v;
+        p = e;
+      }
+      if (*p != ']') break;
+      (*nrows)++;
+    }
+    rc = (p == NULL) ? 0 : -1;
+  }
+  free(buf);
+  return rc;
+}
+
+// Mann-Whitney U test of `now` against `base`. U counts the (now, base)
+// pairs where now is slower, ties as 1/2. If both came from one
+// distribution, *p_slow is the exact chance of U or more, *p_fast of U or
+// less, and *p_min the smallest p these run counts can give. Returns 0, or
+// -1 if out of memory. Ranks, not means: one stalled run cannot make or hide
+// a regression.
+static int mann_whitney(const bench_result *now, const bench_result *base,
+                        double *u_out, double *p_slow, double *p_fast, double *p_min) {
+  const unsigned m = now->runs, k = base->runs;
+  double u = 0;
+  for (unsigned i = 0; i < m; i++) {
+    for (unsigned j = 0; j < k; j++) u += now->ns[i] > base->ns[j] ? 1.0 : now->ns[i] == base->ns[j] ? 0.5 : 0.0;
+  }
+  // P(U = v) for i now-runs and j base-runs: the slowest of all i + j runs
+  // is a now-run (it beats all j base runs) with chance i / (i + j)
+  const size_t w = (size_t)m * k + 1;
+  double *prev = (double*)calloc((size_t)(k + 1) * w, sizeof(double));
+  double *cur = (double*)calloc((size_t)(k + 1) * w, sizeof(double));
+  if (!prev || !cur) {
+    free(prev);
+    free(cur);
+    return -1;
+  }
+  for (unsigned i = 0; i <= m; i++) {
+    for (unsigned j = 0; j <= k; j++) {
+      double *row = cur + (size_t)j * w;
+      if (i == 0 || j == 0) {
+        row[0] = 1;
+        continue;
+      }
+      const double *up = prev + (size_t)j * w, *left = cur + (size_t)(j - 1) * w;
+      for (size_t v = 0; v <= (size_t)i * j; v++) {
+        double a = v >= j ? up[v - j] : 0;
+        double b = v <= (size_t)i * (j - 1) ? left[v] : 0;
+        row[v] = (i * a + j * b) / (i + j);
+      }
+    }
+    double *t = prev; prev = cur; cur = t;
+  }
+  const double *dist = prev + (size_t)k * w;
+  double hi = 0, lo = 0;
+  for (size_t v = 0; v < w; v++) {
+    if ((double)v >= u) hi += dist[v];
+    if ((double)v <= u) lo += dist[v];
+  }
+  *u_out = u;
+  *p_slow = hi;
+  *p_fast = lo;
+  *p_min = dist[w - 1];
+  free(prev);
+  free(cur);
+  return 0;
+}
+
+// Three median absolute deviations of a row's runs, in percent of their
+// median: about two standard deviations, without letting one stalled run
+// widen it.
+static double spread_pct(const bench_result *r) {
+  double med = median(r->ns, r->runs), dev[REPEAT_MAX];
+  for (unsigned k = 0; k < r->runs; k++) dev[k] = fabs(r->ns[k] - med);
+  return 3.0 * median(dev, r->runs) / med * 100.0;
+}
+
+// Mann-Whitney test of each current row against the baseline row of the same
+// name. A row regressed if its runs rank slower (one-sided p < 0.01) and its
+// median moved by more than the noise floor: noise_pct, or the spread of the
+// row's own runs (spread_pct) in either file if that is wider. The rank test only sees the
+// noise inside each session, while whole sessions shift by a few percent
+// (frequency, placement, neighbours); the floor keeps that out. Returns 3 if
+// any row regressed, 1 on a bad or mismatched baseline.
+static int compare_baseline(const char *path, const char *config, double noise_pct) {
+  static bench_result base[RESULTS_MAX];
+  char base_config[256];
+  size_t nbase = 0;
+  if (load_baseline(path, base_config, sizeof(base_config), base, &nbase) != 0) {
+    fprintf(stderr, "cannot read baseline %s\n", path);
+    return 1;
+  }
+  if (strcmp(base_config, config) != 0) {
+    fprintf(stderr, "baseline %s was taken with a different configuration:\n  %s\nvs\n  %s\n",
+            path, base_config, config);
+    return 1;
+  }
+
+  printf("\nvs baseline %s (Mann-Whitney U, regression = one-sided p < 0.01 and median slower by more than the floor)\n",
+         path);
+  printf("%-24s  %10s  %10s  %8s  %7s  %7s  %7s\n", "", "base ns", "now ns", "delta", "floor", "U", "p");
+  int regressed = 0;
+  for (size_t i = 0; i < g_nresults; i++) {
+    const bench_result *r = &g_results[i];
+    const bench_result *b = NULL;
+    for (size_t j = 0; j < nbase && !b; j++) {
+      if (strcmp(base[j].name, r->name) == 0) b = &base[j];
+    }
+    if (!b) {
+      printf("%-24s  (not in baseline)\n", r->name);
+      continue;
+    }
+    double mb = median(b->ns, b->runs), mr = median(r->ns, r->runs);
+    double delta = (mr - mb) / mb * 100.0;
+    double u, p, p_fast, p_min;
+    if (mann_whitney(r, b, &u, &p, &p_fast, &p_min) != 0) {
+      fprintf(stderr, "compare alloc failed\n");
+      return 1;
+    }
+    if (p_min >= 0.01) {
+      printf("%-24s  %10.3f  %10.3f  %+7.2f%%  (needs --repeat >= 5 on both runs)\n", r->name, mb, mr, delta);
+      continue;
+    }
+    double floor = noise_pct;
+    if (spread_pct(b) > floor) floor = spread_pct(b);
+    if (spread_pct(r) > floor) floor = spread_pct(r);
+    const char *verdict = "";
+    if (p < 0.01 && delta > floor) {
+      verdict = "  REGRESSION";
+      regressed = 1;
+    } else if (p_fast < 0.01 && -delta > floor) {
+      verdict = "  faster";
+    }
+    printf("%-24s  %10.3f  %10.3f  %+7.2f%%  %6.2f%%  %7.1f  %7.4f%s\n",
+           r->name, mb, mr, delta, floor, u, p, verdict);
+  }
+  for (size_t j = 0; j < nbase; j++) {
+    int seen = 0;
+    for (size_t i = 0; i < g_nresults && !seen; i++) seen = strcmp(base[j].name, g_results[i].name) == 0;
+    if (!seen) printf("%-24s  (in baseline only)\n", base[j].name);
+  }
+  return regressed ? 3 : 0;
+}
+
+// ------------- memory vs speed (--pareto) ----------------
+
+typedef struct {
+  char     name[40];
+  double   bytes;      // index only; the keys themselves are shared by all rows
+  double   build_ms;
+  double   ns;
+  uint64_t sink;
+} pareto_row;
+
+#define PARETO_MAX_ROWS 128
+
+static void pareto_add(pareto_row *rows, size_t *nrows, const char *name, double bytes,
+                       uint64_t build_ns, find_fn fn, const uint64_t *a, size_t n,
+                       const uint64_t *q, size_t qn) {
+  if (*nrows == PARETO_MAX_ROWS) return;
+  pareto_row *r = &rows[(*nrows)++];
+  snprintf(r->name, sizeof(r->name), "%s", name);
+  r->bytes = bytes;
+  r->build_ms = (double)build_ns / 1e6;
+  r->ns = time_find(fn, a, n, q, qn, &r->sink);
+}
+
+static int pareto_by_bytes(const void *x, const void *y) {
+  const pareto_row *a = (const pareto_row*)x, *b = (const pareto_row*)y;
+  if (a->bytes != b->bytes) return a->bytes < b->bytes ? -1 : 1;
+  return (a->ns > b->ns) - (a->ns < b->ns);
+}
+
+// Sweep K around log2(n) for each directory layout, add the K-free indexes,
+// then print every row by size with the Pareto-optimal ones starred: no
+// smaller-or-equal index answers faster.
+static int pareto_report(const uint64_t *a, size_t n, const uint64_t *q, size_t qn) {
+  pareto_row rows[PARETO_MAX_ROWS];
+  size_t nrows = 0;
+  char name[40];
+  uint64_t t0;
+
+  pareto_add(rows, &nrows, "Binary search", 0, 0, w_binary, a, n, q, qn);
+  pareto_add(rows, &nrows, "Branchless+prefetch", 0, 0, w_branchless, a, n, q, qn);
+  pareto_add(rows, &nrows, "Eytzinger", eyt_bytes(n), g_comp_build_ns[0], w_eytzinger, a, n, q, qn);
+  pareto_add(rows, &nrows, "Static B+tree/16", bt_bytes(), g_comp_build_ns[1], w_btree, a, n, q, qn);
+  pareto_add(rows, &nrows, "Hash (linear probe)", hash_bytes(), g_comp_build_ns[2], w_hash, a, n, q, qn);
+  pareto_add(rows, &nrows, "RadixSpline", rs_bytes(), g_comp_build_ns[3], w_radixspline, a, n, q, qn);
+
+  uint32_t lg = bit_width_u64(n) - 1;
+  uint32_t Klo = lg > 9 ? lg - 8 : 1;
+  uint32_t Khi = lg + 2 < 24 ? lg + 2 : 24;
+  for (uint32_t K = Klo; K <= Khi; K += 2) {
+    const size_t B = (size_t)1 << K;
+    size_t *start = (size_t*)malloc((B + 1) * sizeof(size_t));
+    size_t *tagged = (size_t*)malloc((B + 1) * sizeof(size_t));
+    uint32_t *start32 = (uint32_t*)malloc((B + 1) * sizeof(uint32_t));
+    uint64_t *dense = (uint64_t*)malloc(((B + 63) / 64) * sizeof(uint64_t));
+    bucketsearch_u64_model *model = (bucketsearch_u64_model*)malloc(B * sizeof(bucketsearch_u64_model));
+    if (!start || !tagged || !start32 || !dense || !model) {
+      fprintf(stderr, "pareto alloc failed at K=%u\n", K);
+      return 1;
+    }
+    g_K = K;
+
+    t0 = ns_now();
+    bucketsearch_build_u64(a, n, K, start);
+    uint64_t build_ns = ns_now() - t0;
+    g_start = start;
+    snprintf(name, sizeof(name), "start[] K=%u", K);
+    pareto_add(rows, &nrows, name, (double)(B + 1) * sizeof(size_t), build_ns, w_bucket, a, n, q, qn);
+
+    if (n <= UINT32_MAX) {
+      t0 = ns_now();
+      for (size_t p = 0; p <= B; p++) start32[p] = (uint32_t)start[p];
+      g_start32 = start32;
+      snprintf(name, sizeof(name), "start32[] K=%u", K);
+      pareto_add(rows, &nrows, name, (double)(B + 1) * sizeof(uint32_t),
+                 build_ns + (ns_now() - t0), w_bucket32, a, n, q, qn);
+    }
+
+    t0 = ns_now();
+    bucketsearch_u64_build_dense(a, n, K, start, dense);
+    g_dense = dense;
+    snprintf(name, sizeof(name), "start[]+dense K=%u", K);
+    pareto_add(rows, &nrows, name, (double)(B + 1) * sizeof(size_t) + (double)((B + 63) / 64) * 8,
+               build_ns + (ns_now() - t0), w_bucket_dense, a, n, q, qn);
+
+    t0 = ns_now();
+    bucketsearch_u64_build_model(a, n, K, start, model);
+    g_model = model;
+    snprintf(name, sizeof(name), "start[]+model K=%u", K);
+    pareto_add(rows, &nrows, name, (double)(B + 1) * sizeof(size_t) + (double)B * sizeof(bucketsearch_u64_model),
+               build_ns + (ns_now() - t0), w_bucket_model, a, n, q, qn);
+
+    t0 = ns_now();
+    if (bucketsearch_u64_build_tagged(a, n, K, tagged) == 0) {
+      g_tagged = tagged;
+      snprintf(name, sizeof(name), "tagged K=%u", K);
+      pareto_add(rows, &nrows, name, (double)(B + 1) * sizeof(size_t), ns_now() - t0,
+                 w_bucket_tagged, a, n, q, qn);
+    }
+
+    // lazy: bytes counted after the run, i.e. the leaves these queries touched
+    uint32_t L1 = K / 2 ? K / 2 : 1;
+    uint32_t L2 = K - L1 > 16 ? 16 : K - L1;
+    t0 = ns_now();
+    if (bucketsearch_u64_lazy_init(&g_lazy, a, n, L1, L2) == 0) {
+      uint64_t lazy_ns = ns_now() - t0;
+      snprintf(name, sizeof(name), "lazy K=%u+%u", L1, L2);
+      pareto_add(rows, &nrows, name, 0, lazy_ns, w_lazy, a, n, q, qn);
+      size_t touched = 0;
+      for (uint32_t t = 0; t < (1u << L1); t++) touched += (g_lazy.leaf[t] != NULL);
+      rows[nrows - 1].bytes = (double)(((size_t)1 << L1) + 1) * sizeof(size_t)
+                            + (double)(1u << L1) * sizeof(size_t*)
+                            + (double)touched * (((size_t)1 << L2) + 1) * sizeof(size_t);
+      bucketsearch_u64_lazy_free(&g_lazy);
+    }
+
+    free(start);
+    free(tagged);
+    free(start32);
+    free(dense);
+    free(model);
+  }
+
+  for (uint32_t m = 4; m <= 64; m *= 4) {
+    size_t cnt = bucketsearch_u64_sample_count(n, m);
+    uint64_t *sample = (uint64_t*)malloc((cnt + 1) * sizeof(uint64_t));
+    if (!sample) continue;
+    t0 = ns_now();
+    bucketsearch_u64_build_sample(a, n, m, sample);
+    g_sample = sample;
+    g_m = m;
+    snprintf(name, sizeof(name), "sampled m=%u", m);
+    pareto_add(rows, &nrows, name, (double)(cnt + 1) * sizeof(uint64_t), ns_now() - t0, w_sample, a, n, q, qn);
+    free(sample);
+  }
+
+  size_t ck_words = bucketsearch_u64_cuckoo_words(n);
+  uint64_t *ck = (uint64_t*)malloc(ck_words * sizeof(uint64_t));
+  t0 = ns_now();
+  if (ck && bucketsearch_u64_cuckoo_build(a, n, ck, &g_cuckoo) == 0) {
+    pareto_add(rows, &nrows, "cuckoo sidecar", (double)ck_words * sizeof(uint64_t), ns_now() - t0,
+               w_cuckoo, a, n, q, qn);
+  }
+  free(ck);
+
+  size_t bm_words = bucketsearch_u64_bitmap_words(a, n);
+  uint64_t *bm = bm_words ? (uint64_t*)malloc(bm_words * sizeof(uint64_t)) : NULL;
+  t0 = ns_now();
+  if (bm && bucketsearch_u64_bitmap_build(a, n, bm, &g_bitmap) == 0) {
+    pareto_add(rows, &nrows, "rank bitmap", (double)bm_words * sizeof(uint64_t), ns_now() - t0,
+               w_bitmap, a, n, q, qn);
+  }
+  free(bm);
+
+  uint64_t want = rows[0].sink;
+  qsort(rows, nrows, sizeof(pareto_row), pareto_by_bytes);
+
+  printf("%-24s  %12s  %9s  %10s  %10s\n", "index", "bytes", "bytes/key", "build ms", "ns/query");
+  double best = 0;
+  for (size_t i = 0; i < nrows; i++) {
+    const pareto_row *r = &rows[i];
+    int front = (i == 0 || r->ns < best);
+    if (front) best = r->ns;
+    printf("%-24s  %12.0f  %9.3f  %10.3f  %10.3f  %s%s\n", r->name, r->bytes, r->bytes / (double)n,
+           r->build_ms, r->ns, front ? "*" : "", r->sink != want ? " (sink mismatch)" : "");
+  }
+  printf("\n* = Pareto frontier: faster than every smaller index\n");
+  return 0;
+}
+
+// ------------- self-checks ----------------
+
+// Cheap correctness checks on tricky inputs, run before any timing.
+// Return 0 if they pass.
+
+// Duplicate keys can span a[n-1] - a[0] == n-1 without being one run.
+static int check_dense_dups(void) {
+  static const uint64_t fixed[3] = { 4, 4, 6 };
+  uint64_t a[64];
+  size_t start[(1u << 6) + 1];
+  uint64_t dense[1];
+  rng64_t r = { 99 };
+  for (int round = 0; round < 200; round++) {
+    size_t n = 3;
+    if (round == 0) {
+      memcpy(a, fixed, sizeof(fixed));
+    } else {
+      n = 1 + splitmix64(&r) % 64;
+      a[0] = splitmix64(&r) % 16;
+      for (size_t i = 1; i < n; i++) a[i] = a[i - 1] + splitmix64(&r) % 3;  // steps 0, 1, 2
+    }
+    for (uint32_t K = 1; K <= 6; K++) {
+      if (bucketsearch_u64_build(a, n, K, start) != 0 ||
+          bucketsearch_u64_build_dense(a, n, K, start, dense) != 0) return 1;
+      for (uint64_t x = 0; x <= a[n - 1] + 1; x++) {
+        ptrdiff_t want = bucketsearch_u64_find(a, n, K, start, x);
+        ptrdiff_t got = bucketsearch_u64_find_dense(a, n, K, start, dense, x);
+        if (got != want) {
+          fprintf(stderr, "self-check: find_dense(%llu) = %td, want %td (n=%zu K=%u)\n",
+                  (unsigned long long)x, got, want, n, K);
+          return 1;
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+// Arrow columns with an array offset and leading/trailing nulls: the
+// answer is the logical index in the array.
+static int check_arrow(void) {
+  enum { LEN = 40, OFF = 3 };
+  int64_t sv[OFF + LEN];
+  uint32_t uv[OFF + LEN];
+  uint8_t validity[(OFF + LEN + 7) / 8];
+  memset(validity, 0, sizeof(validity));
+  for (int i = 0; i < OFF + LEN; i++) {
+    sv[i] = (int64_t)(i - OFF) * 7 - 100;   // crosses zero
+    uv[i] = (uint32_t)(i - OFF) * 5 + 1000;
+    int logical = i - OFF;
+    if (logical >= 2 && logical < LEN - 3) validity[i >> 3] |= (uint8_t)(1u << (i & 7));
+  }
+  const void *sbuf[2] = { validity, sv };
+  const void *ubuf[2] = { validity, uv };
+  struct ArrowArray arr = { LEN, 5, OFF, 2, 0, sbuf, NULL, NULL, NULL, NULL };
+  struct ArrowSchema sch = { "l", NULL, NULL, ARROW_FLAG_NULLABLE, 0, NULL, NULL, NULL, NULL };
+  size_t start[(1u << 4) + 1];
+  bucketsearch_u64_arrow_index ix;
+
+  for (int col = 0; col < 2; col++) {
+    sch.format = col ? "I" : "l";
+    arr.buffers = col ? ubuf : sbuf;
+    if (bucketsearch_u64_arrow_build(&sch, &arr, 4, start, &ix) != 0) {
+      fprintf(stderr, "self-check: arrow build failed (format %s)\n", sch.format);
+      return 1;
+    }
+    // the keys span a few hundred from their first: most buckets hold one
+    uint32_t used = 0;
+    for (uint32_t p = 0; p < (1u << 4); p++) used += start[p] != start[p + 1];
+    if (used < 8) {
+      fprintf(stderr, "self-check: arrow keys (format %s) fill only %u of 16 buckets\n",
+              sch.format, used);
+      return 1;
+    }
+    for (int logical = -1; logical <= LEN; logical++) {
+      uint64_t x = col ? (uint64_t)((uint32_t)logical * 5 + 1000) : (uint64_t)((int64_t)logical * 7 - 100);
+      ptrdiff_t want = (logical >= 2 && logical < LEN - 3) ? logical : -1;
+      ptrdiff_t got = bucketsearch_u64_arrow_find(&ix, x);
+      ptrdiff_t miss = bucketsearch_u64_arrow_find(&ix, x + 1);   // between keys
+      if (got != want || miss != -1) {
+        fprintf(stderr, "self-check: arrow find (format %s, index %d) = %td / %td, want %td / -1\n",
+                sch.format, logical, got, miss, want);
+        return 1;
+      }
+    }
+  }
+  // a null inside the column cannot be indexed
+  validity[(OFF + 10) >> 3] &= (uint8_t)~(1u << ((OFF + 10) & 7));
+  if (bucketsearch_u64_arrow_build(&sch, &arr, 4, start, &ix) != -4) {
+    fprintf(stderr, "self-check: arrow build accepted an inner null\n");
+    return 1;
+  }
+  return 0;
+}
+
+// A sorted batch of long runs: the spaced sample sees only distinct keys,
+// so the planner must count the repeats from the neighbours.
+static int check_plan_runs(void) {
+  enum { N = 1 << 16, M = 1 << 20, DISTINCT = 1000, K = 14 };
+  uint64_t *a = (uint64_t*)malloc(N * sizeof(uint64_t));
+  uint64_t *xs = (uint64_t*)malloc(M * sizeof(uint64_t));
+  size_t *start = (size_t*)malloc(((1u << K) + 1) * sizeof(size_t));
+  int bad = !a || !xs || !start;
+  if (!bad) {
+    for (size_t i = 0; i < N; i++) a[i] = 3 * i;
+    for (size_t j = 0; j < M; j++) xs[j] = a[j / (M / DISTINCT + 1) * (N / DISTINCT)];
+    bucketsearch_u64_plan plan;
+    bad = bucketsearch_u64_build(a, N, K, start) != 0 ||
+          bucketsearch_u64_plan_batch(a, N, K, start, xs, M, 0, &plan) != 0;
+    if (!bad && (plan.dups < 0.99 || plan.strategy != BUCKETSEARCH_PLAN_MERGE)) {
+      fprintf(stderr, "self-check: plan of %d sorted runs: dups %.3f, strategy %d\n",
+              DISTINCT, plan.dups, plan.strategy);
+      bad = 1;
+    }
+  }
+  free(a); free(xs); free(start);
+  return bad;
+}
+
+// Unsorted keys whose first and last fit a tiny span: the build must
+// refuse them before writing a bit outside that span.
+static int check_bitmap_unsorted(void) {
+  static const uint64_t keys[3] = { 0, 1000000, 5 };
+  size_t words = bucketsearch_u64_bitmap_words(keys, 3);
+  uint64_t *bm = (uint64_t*)malloc((words ? words : 1) * sizeof(uint64_t));
+  bucketsearch_u64_bitmap b;
+  int bad = !bm || bucketsearch_u64_bitmap_build(keys, 3, bm, &b) == 0;
+  if (bm && bad) fprintf(stderr, "self-check: bitmap build accepted unsorted keys\n");
+  free(bm);
+  return bad;
+}
+
+// Every strategy, and PARTITION at every partition_bits, forced on query
+// orders the planner would not pick it for: each out[] must match
+// bucketsearch_u64_find, including for duplicate keys and misses on both
+// sides of the keys.
+static int check_plan_strategies(void) {
+  enum { N = 20000, M = 6000, K = 10 };
+  static const char *orders[4] = { "random", "descending", "duplicates", "sorted runs" };
+  uint64_t *a = (uint64_t*)malloc(N * sizeof(uint64_t));
+  uint64_t *xs = (uint64_t*)malloc(M * sizeof(uint64_t));
+  ptrdiff_t *out = (ptrdiff_t*)malloc(M * sizeof(ptrdiff_t));
+  size_t *start = (size_t*)malloc(((1u << K) + 1) * sizeof(size_t));
+  int bad = !a || !xs || !out || !start;
+  rng64_t r = { 17 };
+  if (!bad) {
+    a[0] = 5;
+    for (size_t i = 1; i < N; i++) a[i] = a[i - 1] + splitmix64(&r) % 4;  // steps 0..3
+    bad = bucketsearch_u64_build(a, N, K, start) != 0;
+  }
+  const uint64_t span = bad ? 0 : a[N - 1] + 10;
+  for (int order = 0; order < 4 && !bad; order++) {
+    for (size_t j = 0; j < M; j++) {
+      switch (order) {
+        case 0: xs[j] = splitmix64(&r) % span; break;
+        case 1: xs[j] = span - 1 - j * (span / M); break;
+        case 2: xs[j] = a[splitmix64(&r) % 8 * (N / 8)] + splitmix64(&r) % 2; break;
+        default: xs[j] = (j % 500) * (span / 500) + splitmix64(&r) % 3; break;  // ascends, restarts
+      }
+    }
+    for (int strategy = BUCKETSEARCH_PLAN_SCALAR; strategy <= BUCKETSEARCH_PLAN_MERGE && !bad; strategy++) {
+      uint32_t bits_max = strategy == BUCKETSEARCH_PLAN_PARTITION ? K : 0;
+      for (uint32_t bits = strategy == BUCKETSEARCH_PLAN_PARTITION ? 1 : 0; bits <= bits_max && !bad; bits++) {
+        static const size_t sizes[3] = { 1, 77, M };
+        for (int s = 0; s < 3 && !bad; s++) {
+          bucketsearch_u64_plan plan;
+          memset(&plan, 0, sizeof(plan));
+          plan.strategy = strategy;
+          plan.partition_bits = bits;
+          if (bucketsearch_u64_find_planned(a, N, K, start, &plan, xs, sizes[s], out) != 0) {
+            fprintf(stderr, "self-check: strategy %d bits %u failed on %s queries\n", strategy, bits, orders[order]);
+            bad = 1;
+          }
+          for (size_t j = 0; j < sizes[s] && !bad; j++) {
+            ptrdiff_t want = bucketsearch_u64_find(a, N, K, start, xs[j]);
+            if (out[j] != want) {
+              fprintf(stderr, "self-check: strategy %d bits %u, %s queries: out[%zu] = %td for %llu, want %td\n",
+                      strategy, bits, orders[order], j, out[j], (unsigned long long)xs[j], want);
+              bad = 1;
+            }
+          }
+        }
+      }
+    }
+  }
+  free(a); free(xs); free(out); free(start);
+  return bad;
+}
+
+static int self_check(void) {
+  return check_dense_dups() || check_arrow() || check_plan_runs() ||
+         check_bitmap_unsorted() || check_plan_strategies();
+}
+
 int main(int argc, char **argv) {
-  size_t   n = (argc > 1) ? (size_t)strtoull(argv[1], NULL, 10) : 5000000ull;
-  size_t   qn = (argc > 2) ? (size_t)strtoull(argv[2], NULL, 10) : 2000000ull;
-  uint32_t K = (argc > 3) ? (uint32_t)strtoul(argv[3], NULL, 10) : 16u;
-  int hit_percent = (argc > 4) ? atoi(argv[4]) : 50;
-  uint64_t seed = (argc > 5) ? (uint64_t)strtoull(argv[5], NULL, 10) : 123ull;
+  // split "--opt=value" flags from positional args
+  const char *pos[5] = { NULL, NULL, NULL, NULL, NULL };
+  int npos = 0;
+  const char *dist = "sparse";
+  const char *qdist = "uniform";
+  const char *keys_path = NULL;
+  int pareto = 0;
+  int build = 0;
+  int sweep = 0;
+  int scaling = 0;
+  const char *save_path = NULL;
+  const char *compare_path = NULL;
+  double noise_pct = 5.0;
+  unsigned threads = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--dist=", 7) == 0) dist = argv[i] + 7;
+    else if (strncmp(argv[i], "--qdist=", 8) == 0) qdist = argv[i] + 8;
+    else if (strncmp(argv[i], "--keys=", 7) == 0) keys_path = argv[i] + 7;
+    else if (strcmp(argv[i], "--pareto") == 0) pareto = 1;
+    else if (strcmp(argv[i], "--build") == 0) build = 1;
+    else if (strcmp(argv[i], "--batch-sweep") == 0) sweep = 1;
+    else if (strcmp(argv[i], "--scaling") == 0) scaling = 1;
+    else if (strncmp(argv[i], "--threads=", 10) == 0) threads = (unsigned)strtoul(argv[i] + 10, NULL, 10);
+    else if (strncmp(argv[i], "--repeat=", 9) == 0) g_repeat = (unsigned)strtoul(argv[i] + 9, NULL, 10);
+    else if (strncmp(argv[i], "--save=", 7) == 0) save_path = argv[i] + 7;
+    else if (strncmp(argv[i], "--compare=", 10) == 0) compare_path = argv[i] + 10;
+    else if (strncmp(argv[i], "--noise=", 8) == 0) noise_pct = strtod(argv[i] + 8, NULL);
+    else if (strcmp(argv[i], "--cold") == 0) g_cache_mode = CACHE_COLD;
+    else if (strncmp(argv[i], "--sporadic=", 11) == 0) {
+      g_cache_mode = CACHE_SPORADIC;
+      g_work_bytes = (size_t)strtoull(argv[i] + 11, NULL, 10);
+    }
+    else if (strncmp(argv[i], "--", 2) == 0) {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+    else if (npos < 5) pos[npos++] = argv[i];
+  }
+  if (strcmp(dist, "sparse") != 0 && strcmp(dist, "dense") != 0 && strcmp(dist, "skew") != 0) {
+    fprintf(stderr, "--dist must be sparse, dense or skew\n");
+    return 1;
+  }
+  if (strcmp(qdist, "uniform") != 0 && strcmp(qdist, "window") != 0) {
+    fprintf(stderr, "--qdist must be uniform or window\n");
+    return 1;
+  }
+  if (g_repeat == 0 || g_repeat > REPEAT_MAX) {
+    fprintf(stderr, "--repeat must be in [1..%d]\n", REPEAT_MAX);
+    return 1;
+  }
+  if ((save_path || compare_path) && (build || pareto || sweep || scaling)) {
+    fprintf(stderr, "--save and --compare apply to the usual rows only\n");
+    return 1;
+  }
 
-  const uint64_t maxV = 10ull * 1000ull * 1000ull * 1000ull * 1000ull; // 10 trillion
+  size_t   n = pos[0] ? (size_t)strtoull(pos[0], NULL, 10) : 5000000ull;
+  size_t   qn = pos[1] ? (size_t)strtoull(pos[1], NULL, 10) : 2000000ull;
+  uint32_t K = pos[2] ? (uint32_t)strtoul(pos[2], NULL, 10) : 16u;
+  int hit_percent = pos[3] ? atoi(pos[3]) : 50;
+  uint64_t seed = pos[4] ? (uint64_t)strtoull(pos[4], NULL, 10) : 123ull;
+
+  uint64_t maxV = 10ull * 1000ull * 1000ull * 1000ull * 1000ull; // 10 trillion
   const uint64_t avg_gap = 1000; // controls sparsity (increase for more gaps)
 
-  printf("n=%zu  queries=%zu  K=%u  hit%%=%d  seed=%llu\n",
-         n, qn, K, hit_percent, (unsigned long long)seed);
+  bucketsearch_u64_mapped mapped = { NULL, 0, NULL, 0 };
+  if (keys_path) {
+    int rc = bucketsearch_u64_map_keys(keys_path, 0, &mapped);
+    if (rc != 0 || mapped.n == 0) {
+      fprintf(stderr, "cannot map keys from %s (rc=%d)\n", keys_path, rc);
+      return 1;
+    }
+    n = mapped.n;
+    dist = keys_path;
+  }
+
+  if (self_check() != 0) return 1;
+
+  printf("n=%zu  queries=%zu  K=%u  hit%%=%d  seed=%llu  dist=%s  qdist=%s\n",
+         n, qn, K, hit_percent, (unsigned long long)seed, dist, qdist);
 
-  uint64_t *a = (uint64_t*)malloc(n * sizeof(uint64_t));
+  uint64_t *keys = keys_path ? NULL : (uint64_t*)malloc(n * sizeof(uint64_t));
   uint64_t *q = (uint64_t*)malloc(qn * sizeof(uint64_t));
-  if (!a || !q) {
+  if ((!keys && !keys_path) || !q) {
     fprintf(stderr, "alloc failed\n");
     return 1;
   }
 
-  gen_sorted_sparse_u64(a, n, maxV, avg_gap, seed);
-  gen_queries_u64(q, qn, a, n, maxV, hit_percent, seed ^ 0xDEADBEEFCAFEBABEull);
+  if (keys_path) {
+    maxV = mapped.keys[n - 1] ? mapped.keys[n - 1] : 1;
+  } else if (strcmp(dist, "dense") == 0) {
+    gen_sorted_dense_u64(keys, n, seed);
+    maxV = n ? keys[n - 1] : 1; // misses drawn from the id range itself
+  } else if (strcmp(dist, "skew") == 0) {
+    gen_sorted_skew_u64(keys, n, seed);
+    maxV = n ? keys[n - 1] : 1;
+  } else {
+    gen_sorted_sparse_u64(keys, n, maxV, avg_gap, seed);
+  }
+  const uint64_t *a = keys_path ? mapped.keys : keys;
+  if (strcmp(qdist, "window") == 0)
+    gen_queries_window_u64(q, qn, a, n, hit_percent, seed ^ 0xDEADBEEFCAFEBABEull);
+  else
+    gen_queries_u64(q, qn, a, n, maxV, hit_percent, seed ^ 0xDEADBEEFCAFEBABEull);
+
+  uint8_t *evict = NULL;
+  if (g_cache_mode != CACHE_HOT) {
+    // 1.5x the last-level cache, so streaming it leaves none of the index behind
+    size_t llc = llc_bytes();
+    g_evict_bytes = llc ? llc + llc / 2 : (size_t)64 << 20;
+    evict = (uint8_t*)malloc(g_evict_bytes);
+    if (!evict) {
+      fprintf(stderr, "eviction buffer alloc failed\n");
+      return 1;
+    }
+    memset(evict, 1, g_evict_bytes);
+    g_evict = evict;
+    if (g_cache_mode == CACHE_COLD) {
+      printf("(cache: cold, %.1f MiB streamed before every %d lookups, %zu lookups per row)\n",
+             (double)g_evict_bytes / (1 << 20), COLD_GROUP, mode_queries(qn));
+    } else {
+      g_timer_ns = timer_overhead_ns();
+      printf("(cache: sporadic, %zu bytes of untimed traffic before every lookup, each timed alone less %llu ns of timer)\n",
+             g_work_bytes, (unsigned long long)g_timer_ns);
+    }
+  }
+
+  if (sweep || scaling) {
+    int rc = (K == 0 || K > 24) ? 1
+           : sweep ? batch_sweep_report(a, n, K, q, qn, threads)
+           : scaling_report(a, n, K, q, qn, threads);
+    if (K == 0 || K > 24) fprintf(stderr, "Choose K in [1..24]\n");
+    free(evict);
+    free(q);
+    free(keys);
+    bucketsearch_u64_unmap(&mapped);
+    return rc;
+  }
+
+  if (!build && competitors_build(a, n) != 0) {
+    fprintf(stderr, "competitor build failed\n");
+    return 1;
+  }
+
+  if (build || pareto) {
+    int rc = build ? build_report(a, n) : pareto_report(a, n, q, qn);
+    competitors_free();
+    free(evict);
+    free(q);
+    free(keys);
+    bucketsearch_u64_unmap(&mapped);
+    return rc;
+  }
 
   // Build BucketSearch table
   if (K == 0 || K > 24) {
@@ -283,27 +2128,228 @@ int main(int argc, char **argv) {
     fprintf(stderr, "start alloc failed\n");
     return 1;
   }
+  uint64_t tb0 = ns_now();
   if (bucketsearch_build_u64(a, n, K, start) != 0) {
     fprintf(stderr, "bucketsearch_build failed\n");
     return 1;
   }
+  uint64_t build_ns = ns_now() - tb0;
   g_start = start;
   g_K = K;
+  if (bucketsearch_u64_heatmap_init(&g_heatmap, K, 64) != 0) {
+    fprintf(stderr, "heatmap init failed\n");
+    return 1;
+  }
+
+  uint64_t *dense = (uint64_t*)malloc(((B + 63) / 64) * sizeof(uint64_t));
+  if (!dense || bucketsearch_u64_build_dense(a, n, K, start, dense) != 0) {
+    fprintf(stderr, "dense build failed\n");
+    return 1;
+  }
+  g_dense = dense;
+
+  bucketsearch_u64_model *model = (bucketsearch_u64_model*)malloc(B * sizeof(bucketsearch_u64_model));
+  if (!model || bucketsearch_u64_build_model(a, n, K, start, model) != 0) {
+    fprintf(stderr, "model build failed\n");
+    return 1;
+  }
+  g_model = model;
+  size_t max_bucket = 0;
+  uint64_t err_sum = 0;
+  for (size_t p = 0; p < B; p++) {
+    if (start[p + 1] - start[p] > max_bucket) max_bucket = start[p + 1] - start[p];
+    err_sum += model[p].err;
+  }
+
+  size_t *tagged = (size_t*)malloc((B + 1) * sizeof(size_t));
+  if (!tagged || bucketsearch_u64_build_tagged(a, n, K, tagged) != 0) {
+    fprintf(stderr, "tagged build failed\n");
+    return 1;
+  }
+  g_tagged = tagged;
+
+  // Sampled directory, 16 keys (two cache lines) per entry whatever K is:
+  // n / 2^K collapses to 1 once 2^K >= n, which copies every key
+  g_m = 16;
+  uint64_t *sample = (uint64_t*)malloc((bucketsearch_u64_sample_count(n, g_m) + 1) * sizeof(uint64_t));
+  if (!sample || bucketsearch_u64_build_sample(a, n, g_m, sample) != 0) {
+    fprintf(stderr, "sample build failed\n");
+    return 1;
+  }
+  g_sample = sample;
+
+  // Adaptive: coarse K/2 table, K - K/2 more bits for at most 1/16 of the
+  // coarse buckets, refined every 4K lookups
+  uint32_t K0 = K / 2 ? K / 2 : 1;
+  uint32_t max_sub = (1u << K0) / 16 ? (1u << K0) / 16 : 1;
+  if (bucketsearch_u64_adaptive_init(&g_adaptive, a, n, K0, K - K0, max_sub, 1u << 12) != 0) {
+    fprintf(stderr, "adaptive init failed\n");
+    return 1;
+  }
+
+  // Lazy: same K split into K/2 eager bits and K - K/2 bits built on touch
+  uint32_t L1 = K / 2 ? K / 2 : 1;
+  uint32_t L2 = K - L1 > 16 ? 16 : K - L1;
+  tb0 = ns_now();
+  if (bucketsearch_u64_lazy_init(&g_lazy, a, n, L1, L2) != 0) {
+    fprintf(stderr, "lazy init failed\n");
+    return 1;
+  }
+  uint64_t lazy_ns = ns_now() - tb0;
+
+  row24_t *rows = (row24_t*)malloc(n * sizeof(row24_t));
+  size_t *row_start = (size_t*)malloc((B + 1) * sizeof(size_t));
+  if (!rows || !row_start) {
+    fprintf(stderr, "rows alloc failed\n");
+    return 1;
+  }
+  for (size_t i = 0; i < n; i++) {
+    rows[i].pre = i;
+    rows[i].key = a[i];
+    rows[i].post = ~(uint64_t)i;
+  }
+  if (bucketsearch_u64_build_rows(rows, n, sizeof(row24_t), offsetof(row24_t, key), K, row_start) != 0) {
+    fprintf(stderr, "rows build failed\n");
+    return 1;
+  }
+  g_rows = rows;
+  g_row_start = row_start;
+
+  size_t ck_words = bucketsearch_u64_cuckoo_words(n);
+  uint64_t *ck = (uint64_t*)malloc(ck_words * sizeof(uint64_t));
+  if (!ck || bucketsearch_u64_cuckoo_build(a, n, ck, &g_cuckoo) != 0) {
+    fprintf(stderr, "cuckoo build failed\n");
+    return 1;
+  }
+
+  // Rank bitmap only exists for dense universes
+  size_t bm_words = bucketsearch_u64_bitmap_words(a, n);
+  uint64_t *bm = bm_words ? (uint64_t*)malloc(bm_words * sizeof(uint64_t)) : NULL;
+  if (bm && bucketsearch_u64_bitmap_build(a, n, bm, &g_bitmap) != 0) {
+    free(bm);
+    bm = NULL;
+  }
 
   // Warm-up (touch memory)
   volatile uint64_t warm = 0;
   for (size_t i = 0; i < n; i += (n / 1024 + 1)) warm ^= a[i];
   for (size_t i = 0; i < qn; i += (qn / 1024 + 1)) warm ^= q[i];
-  printf("(warm=%llu)\n\n", (unsigned long long)warm);
+  printf("(warm=%llu)\n", (unsigned long long)warm);
+  printf("(start[]: %.3f bytes/key, cuckoo sidecar: %.3f bytes/key)\n",
+         (double)(B + 1) * sizeof(size_t) / (double)n,
+         (double)ck_words * sizeof(uint64_t) / (double)n);
+  printf("(build: start[] %.3f ms, lazy top level %.3f ms)\n",
+         (double)build_ns / 1e6, (double)lazy_ns / 1e6);
+  printf("(competitors, bytes/key beyond the keys: eytzinger %.3f, b+tree %.3f, hash %.3f, radixspline %.3f with %zu points)\n",
+         eyt_bytes(n) / (double)n, bt_bytes() / (double)n, hash_bytes() / (double)n,
+         rs_bytes() / (double)n, g_rs_n);
+  printf("(largest bucket: %zu keys, mean model err: %.2f, sampled m=%u)\n",
+         max_bucket, (double)err_sum / (double)B, g_m);
+  if (bm) {
+    printf("(rank bitmap: %.3f bits/key, keys+start: %.3f bits/key)\n",
+           (double)bm_words * 64.0 / (double)n,
+           (double)(n + B + 1) * 64.0 / (double)n);
+  } else {
+    printf("(rank bitmap skipped: universe too sparse)\n");
+  }
+  printf("\n");
+
+  // planner on blocks of 64K, as given and sorted; the queries a row runs
+  // are sorted among themselves, so the sink matches
+  uint64_t *qs = (uint64_t*)malloc(qn * sizeof(uint64_t));
+  if (!qs) {
+    fprintf(stderr, "sorted queries alloc failed\n");
+    return 1;
+  }
+  memcpy(qs, q, qn * sizeof(uint64_t));
+  qsort(qs, mode_queries(qn), sizeof(uint64_t), cmp_u64_asc);
+  qsort(qs + mode_queries(qn), qn - mode_queries(qn), sizeof(uint64_t), cmp_u64_asc);
 
-  bench_find("Binary search",      w_binary,       a, n, q, qn);
-  bench_find("libc bsearch",       w_libc_bsearch, a, n, q, qn);
-  bench_find("Interpolation",      w_interp,       a, n, q, qn);
-  bench_find("BucketSearch",       w_bucket,       a, n, q, qn);
+  static bench_row table[] = {
+    { .name = "Binary search", .fn = w_binary },
+    { .name = "libc bsearch", .fn = w_libc_bsearch },
+    { .name = "Interpolation", .fn = w_interp },
+    { .name = "Branchless+prefetch", .fn = w_branchless },
+    { .name = "Eytzinger", .fn = w_eytzinger },
+    { .name = "Static B+tree/16", .fn = w_btree },
+    { .name = "Hash (linear probe)", .fn = w_hash },
+    { .name = "RadixSpline", .fn = w_radixspline },
+    { .name = "BucketSearch", .fn = w_bucket },
+    { .name = "BucketSearch batch", .bfn = bucketsearch_u64_find_batch, .block = 1024 },
+    { .name = "Planned batch", .bfn = planned_batch, .block = 65536 },
+    { .name = "Planned, sorted queries", .bfn = planned_batch, .block = 65536 },
+    { .name = "BucketSearch heat 1/64", .fn = w_heatmap },
+    { .name = "BucketSearch+dense", .fn = w_bucket_dense },
+    { .name = "BucketSearch+model", .fn = w_bucket_model },
+    { .name = "BucketSearch+tagged", .fn = w_bucket_tagged },
+    { .name = "Sampled directory", .fn = w_sample },
+    { .name = "Adaptive (refined)", .fn = w_adaptive },
+    { .name = "Lazy directory", .fn = w_lazy },
+    { .name = "BucketSearch rows/24", .fn = w_rows },
+    { .name = "Cuckoo sidecar", .fn = w_cuckoo },
+    { .name = "Rank bitmap", .fn = w_bitmap },
+  };
+  size_t nrows = sizeof(table) / sizeof(table[0]) - (bm ? 0 : 1);  // rank bitmap last
+  for (size_t i = 0; i < nrows; i++) table[i].q = q;
+  find_row(table, nrows, "Planned, sorted queries")->q = qs;
 
+  static const char *plan_names[4] = { "scalar", "prefetch", "partition", "merge" };
+  size_t pm = qn < 65536 ? qn : 65536;
+  bucketsearch_u64_plan plan_q, plan_qs;
+  bucketsearch_u64_plan_batch(a, n, K, start, q, pm, 0, &plan_q);
+  bucketsearch_u64_plan_batch(a, n, K, start, qs, pm, 0, &plan_qs);
+  snprintf(find_row(table, nrows, "Planned, sorted queries")->note, sizeof(table[0].note),
+           "(first block: %s, sorted %s; dups %.2f)", plan_names[plan_q.strategy], plan_names[plan_qs.strategy], plan_q.dups);
+
+  run_rows(table, nrows, a, n, K, start, qn);
+
+  size_t hot = 0;
+  for (size_t p = 1; p < B; p++) {
+    if (g_heatmap.hits[p] > g_heatmap.hits[hot]) hot = p;
+  }
+  snprintf(find_row(table, nrows, "BucketSearch heat 1/64")->note, sizeof(table[0].note),
+           "(%llu sampled, hottest bucket %zu: %u hits, %zu keys, mean depth %.2f)",
+           (unsigned long long)g_heatmap.sampled, hot, g_heatmap.hits[hot], start[hot + 1] - start[hot],
+           g_heatmap.hits[hot] ? (double)g_heatmap.depth[hot] / g_heatmap.hits[hot] : 0.0);
+  snprintf(find_row(table, nrows, "Adaptive (refined)")->note, sizeof(table[0].note),
+           "(coarse K=%u, %u/%u sub-tables of 2^%u live, %.3f bytes/key)",
+           K0, g_adaptive.nsub, max_sub, g_adaptive.sub_K,
+           (double)(((size_t)1 << K0) + 1 + (size_t)g_adaptive.nsub * (((size_t)1 << g_adaptive.sub_K) + 1))
+             * sizeof(size_t) / (double)n);
+  uint32_t touched = 0;
+  for (uint32_t t = 0; t < (1u << L1); t++) touched += (g_lazy.leaf[t] != NULL);
+  snprintf(find_row(table, nrows, "Lazy directory")->note, sizeof(table[0].note), "(%u/%u leaves materialized)", touched, 1u << L1);
+  print_rows(table, nrows);
+
+  int rc = 0;
+  if (save_path || compare_path) {
+    char config[256];
+    snprintf(config, sizeof(config), "n=%zu queries=%zu K=%u hit=%d seed=%llu dist=%s qdist=%s cache=%s/%zu",
+             n, qn, K, hit_percent, (unsigned long long)seed, dist, qdist,
+             g_cache_mode == CACHE_COLD ? "cold" : g_cache_mode == CACHE_SPORADIC ? "sporadic" : "hot",
+             g_work_bytes);
+    if (compare_path) rc = compare_baseline(compare_path, config, noise_pct);
+    if (save_path && save_baseline(save_path, config) != 0 && rc == 0) rc = 1;
+  }
+
+  free(qs);
+  free(bm);
+  free(ck);
+  free(model);
+  free(tagged);
+  free(sample);
+  bucketsearch_u64_adaptive_free(&g_adaptive);
+  bucketsearch_u64_heatmap_free(&g_heatmap);
+  bucketsearch_u64_lazy_free(&g_lazy);
+  free(row_start);
+  free(rows);
+  free(dense);
   free(start);
+  competitors_free();
+  free(evict);
   free(q);
-  free(a);
-  return 0;
+  free(keys);
+  bucketsearch_u64_unmap(&mapped);
+  return rc;
 }
 
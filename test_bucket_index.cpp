@@ -0,0 +1,65 @@
+// Compile-time checks: BucketIndex from bucket_search_u64.hpp built and
+// queried in constant expressions. Compiling this file is the test.
+// Build:
+//   g++ -std=c++17 -fsyntax-only test_bucket_index.cpp
+
+#include <array>
+#include <cstdint>
+
+#include "bucket_search_u64.hpp"
+
+using bucketsearch::make_bucket_index;
+
+namespace {
+
+constexpr auto ids = make_bucket_index<4>(std::array<std::uint64_t, 5>{3, 17, 42, 99, 1000});
+static_assert(ids.valid(), "sorted keys");
+static_assert(ids.size() == 5, "size");
+static_assert(ids.start()[0] == 0 && ids.start()[ids.buckets] == 5, "start[] spans the keys");
+
+// hits, first to last
+static_assert(ids.find(3) == 0 && ids.find(17) == 1 && ids.find(42) == 2, "hit");
+static_assert(ids.find(99) == 3 && ids.find(1000) == 4, "hit");
+static_assert(ids.contains(42), "contains");
+
+// misses: below, between, inside a bucket, above the largest key
+static_assert(ids.find(0) == -1 && ids.find(2) == -1, "miss below");
+static_assert(ids.find(18) == -1 && ids.find(98) == -1 && ids.find(999) == -1, "miss between");
+static_assert(ids.find(1001) == -1 && ids.find(UINT64_MAX) == -1, "miss above");
+static_assert(!ids.contains(4), "contains on a miss");
+
+// lower_bound: on keys, between keys and past both ends
+static_assert(ids.lower_bound(0) == 0 && ids.lower_bound(3) == 0, "lower_bound at the front");
+static_assert(ids.lower_bound(4) == 1 && ids.lower_bound(42) == 2 && ids.lower_bound(43) == 3,
+              "lower_bound between keys");
+static_assert(ids.lower_bound(1000) == 4 && ids.lower_bound(1001) == 5 &&
+              ids.lower_bound(UINT64_MAX) == 5, "lower_bound past the end");
+
+// empty array
+constexpr auto none = make_bucket_index<3>(std::array<std::uint64_t, 0>{});
+static_assert(none.valid() && none.size() == 0, "empty");
+static_assert(none.find(0) == -1 && none.find(UINT64_MAX) == -1, "empty find");
+static_assert(none.lower_bound(0) == 0 && none.lower_bound(UINT64_MAX) == 0, "empty lower_bound");
+
+// one key, and K wider than the keys' bit width (prefix shifts left)
+constexpr auto one = make_bucket_index<8>(std::array<std::uint64_t, 1>{5});
+static_assert(one.find(5) == 0 && one.find(4) == -1 && one.find(6) == -1, "single key");
+static_assert(one.lower_bound(4) == 0 && one.lower_bound(6) == 1, "single key lower_bound");
+
+// duplicates: lower_bound lands on the first copy
+constexpr auto dups = make_bucket_index<2>(std::array<std::uint64_t, 6>{1, 7, 7, 7, 12, 15});
+static_assert(dups.valid(), "equal neighbours are sorted");
+static_assert(dups.find(7) == 1 && dups.lower_bound(7) == 1 && dups.lower_bound(8) == 4,
+              "duplicates");
+
+// keys spanning the full 64-bit range
+constexpr auto wide = make_bucket_index<6>(
+    std::array<std::uint64_t, 4>{0, 1, UINT64_MAX / 2, UINT64_MAX});
+static_assert(wide.find(0) == 0 && wide.find(1) == 1 && wide.find(UINT64_MAX) == 3, "wide hit");
+static_assert(wide.find(2) == -1 && wide.lower_bound(2) == 2, "wide miss");
+
+// unsorted keys are reported, not silently indexed
+constexpr auto bad = make_bucket_index<4>(std::array<std::uint64_t, 3>{9, 2, 5});
+static_assert(!bad.valid(), "unsorted");
+
+}  // namespace
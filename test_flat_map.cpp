@@ -0,0 +1,142 @@
+// Behaviour checks: bucket_flat_set / bucket_flat_map against std::set /
+// std::map under random inserts, bulk inserts with duplicates and erases.
+// Build:
+//   g++ -std=c++17 -O2 test_flat_map.cpp -o test_flat_map
+// Run:
+//   ./test_flat_map        (exit status 0 when every check passes)
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "bucket_flat_map.hpp"
+
+using bucketsearch::bucket_flat_map;
+using bucketsearch::bucket_flat_set;
+
+static std::uint64_t splitmix64(std::uint64_t *s) {
+  std::uint64_t z = (*s += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+// Every lookup on probes lo-1 .. hi+1 agrees with the reference set.
+template <typename Key>
+static int same_set(const bucket_flat_set<Key> &got, const std::set<Key> &want,
+                    Key lo, Key hi, const char *what) {
+  if (got.size() != want.size() ||
+      !std::equal(got.begin(), got.end(), want.begin(), want.end())) {
+    std::fprintf(stderr, "self-check: %s: contents differ (size %zu, want %zu)\n",
+                 what, got.size(), want.size());
+    return 1;
+  }
+  for (Key x = lo - 1;; x++) {
+    auto ref = want.lower_bound(x);
+    std::size_t want_lb = static_cast<std::size_t>(std::distance(want.begin(), ref));
+    std::size_t want_ub = static_cast<std::size_t>(std::distance(want.begin(), want.upper_bound(x)));
+    std::size_t lb = static_cast<std::size_t>(got.lower_bound(x) - got.begin());
+    std::size_t ub = static_cast<std::size_t>(got.upper_bound(x) - got.begin());
+    if (lb != want_lb || ub != want_ub || got.contains(x) != (want.count(x) != 0)) {
+      std::fprintf(stderr, "self-check: %s: key %" PRId64 ": lower %zu upper %zu, want %zu %zu\n",
+                   what, static_cast<std::int64_t>(x), lb, ub, want_lb, want_ub);
+      return 1;
+    }
+    if (x == hi + 1) break;
+  }
+  return 0;
+}
+
+// Signed keys around zero, single inserts interleaved with finds, erases.
+template <typename Key>
+static int check_signed(const char *what) {
+  std::uint64_t r = 7;
+  bucket_flat_set<Key> s;
+  std::set<Key> ref;
+  for (int i = 0; i < 3000; i++) {
+    Key k = static_cast<Key>(static_cast<std::int64_t>(splitmix64(&r) % 2001) - 1000);
+    if (splitmix64(&r) % 4 == 0) {
+      if (s.erase(k) != ref.erase(k)) {
+        std::fprintf(stderr, "self-check: %s: erase(%" PRId64 ") disagrees\n", what,
+                     static_cast<std::int64_t>(k));
+        return 1;
+      }
+    } else if (s.insert(k).second != ref.insert(k).second) {
+      std::fprintf(stderr, "self-check: %s: insert(%" PRId64 ") disagrees\n", what,
+                   static_cast<std::int64_t>(k));
+      return 1;
+    }
+    if (s.contains(k) != (ref.count(k) != 0)) {
+      std::fprintf(stderr, "self-check: %s: contains(%" PRId64 ") after update\n", what,
+                   static_cast<std::int64_t>(k));
+      return 1;
+    }
+  }
+  if (same_set<Key>(s, ref, -1000, 1000, what)) return 1;
+
+  // keys outside the directory's range on both sides, then erase by iterator
+  Key edge[4] = { -5000, 5000, -1001, 1001 };
+  for (Key k : edge) { s.insert(k); ref.insert(k); }
+  while (s.size() > 100) {
+    auto it = s.begin() + static_cast<std::ptrdiff_t>(splitmix64(&r) % s.size());
+    ref.erase(*it);
+    s.erase(it);
+  }
+  if (same_set<Key>(s, ref, -5000, 5000, what)) return 1;
+
+  // erase by a key that lives in the container
+  while (s.size() > 10) {
+    Key k = *(s.begin() + static_cast<std::ptrdiff_t>(splitmix64(&r) % s.size()));
+    ref.erase(k);
+    s.erase(*s.find(k));
+  }
+  return same_set<Key>(s, ref, -5000, 5000, what);
+}
+
+// Bulk inserts with repeated keys: existing and first-inserted elements win.
+static int check_dups(void) {
+  std::uint64_t r = 11;
+  bucket_flat_map<std::int64_t, int> m;
+  std::map<std::int64_t, int> ref;
+  for (int round = 0; round < 20; round++) {
+    std::vector<std::pair<std::int64_t, int>> batch;
+    for (int i = 0; i < 200; i++) {
+      std::int64_t k = static_cast<std::int64_t>(splitmix64(&r) % 300) - 150;
+      batch.emplace_back(k, round * 1000 + i);
+    }
+    m.insert(batch.begin(), batch.end());
+    for (auto &kv : batch) ref.insert(kv);
+    m[static_cast<std::int64_t>(round) - 10] += 1;
+    ref[static_cast<std::int64_t>(round) - 10] += 1;
+  }
+  auto same = [](const std::pair<std::int64_t, int> &x, const std::pair<const std::int64_t, int> &y) {
+    return x.first == y.first && x.second == y.second;
+  };
+  if (m.size() != ref.size() || !std::equal(m.begin(), m.end(), ref.begin(), ref.end(), same)) {
+    std::fprintf(stderr, "self-check: duplicates: contents differ\n");
+    return 1;
+  }
+  for (std::int64_t k = -151; k <= 150; k++) {
+    auto it = m.find(k);
+    auto want = ref.find(k);
+    if ((it == m.end()) != (want == ref.end()) || (it != m.end() && it->second != want->second)) {
+      std::fprintf(stderr, "self-check: duplicates: find(%" PRId64 ")\n", k);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int main() {
+  int fail = check_signed<std::int64_t>("int64 keys") ||
+             check_signed<std::int32_t>("int32 keys") ||
+             check_signed<std::int16_t>("int16 keys") ||
+             check_dups();
+  if (!fail) std::printf("flat containers: ok\n");
+  return fail;
+}